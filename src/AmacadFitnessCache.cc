@@ -0,0 +1,130 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "AmacadFitnessCache.h"
+
+#include <cmath>
+
+
+
+AmacadFitnessCache::AmacadFitnessCache() {
+
+	mWeights[0] = mWeights[1] = mWeights[2] = 0;
+	mUpdates = 0;
+
+}
+
+
+
+/**
+ * Set the weights of the distance, speed and destination differences.
+ * Every term changes, so the cache starts again.
+ */
+void AmacadFitnessCache::setWeights( double distance, double speed, double destination ) {
+
+	mWeights[0] = distance;
+	mWeights[1] = speed;
+	mWeights[2] = destination;
+	clear();
+
+}
+
+
+
+/**
+ * Calculate the F term between two nodes.
+ */
+double AmacadFitnessCache::term( const Motion &a, const Motion &b ) const {
+
+	double dL = sqrt( ( a.mX - b.mX ) * ( a.mX - b.mX ) + ( a.mY - b.mY ) * ( a.mY - b.mY ) );
+	double dS = fabs( a.mSpeed - b.mSpeed );
+	double dD = sqrt( ( a.mDestinationX - b.mDestinationX ) * ( a.mDestinationX - b.mDestinationX ) + ( a.mDestinationY - b.mDestinationY ) * ( a.mDestinationY - b.mDestinationY ) );
+	return weigh( dL, dS, dD );
+
+}
+
+
+
+/**
+ * Get the slot of the CM with the given ID, or -1.
+ */
+int AmacadFitnessCache::slotOf( unsigned int id ) const {
+
+	std::vector<unsigned int>::const_iterator it = std::lower_bound( mIds.begin(), mIds.end(), id );
+	if ( it == mIds.end() || *it != id )
+		return -1;
+	return it - mIds.begin();
+
+}
+
+
+
+/**
+ * Set the motion of the CM in the given slot, unless its data version is unchanged.
+ *
+ * The slot's row and column are redone against every slot that has been
+ * set, and the other rows' sums are adjusted by the difference in their
+ * term. Slots not yet set hold 0 terms, so after an assign() each pair is
+ * computed once, when the second of its slots is set.
+ */
+void AmacadFitnessCache::set( unsigned int slot, const Motion &motion, unsigned int version ) {
+
+	if ( mValid[slot] && mVersions[slot] == version )
+		return;
+	mMotions[slot] = motion;
+	mVersions[slot] = version;
+	mValid[slot] = true;
+
+	unsigned int n = mIds.size();
+	double sum = 0;
+	for ( unsigned int j = 0; j < n; j++ ) {
+		if ( j == slot || !mValid[j] )
+			continue;
+		double t = term( motion, mMotions[j] );
+		mSums[j] += t - mTerms[j*n+slot];
+		mTerms[slot*n+j] = mTerms[j*n+slot] = t;
+		sum += t;
+	}
+	mSums[slot] = sum;
+
+	// Resum the rows every so often, so rounding errors in the adjustments don't build up.
+	if ( ++mUpdates >= n ) {
+		for ( unsigned int i = 0; i < n; i++ ) {
+			sum = 0;
+			for ( unsigned int j = 0; j < n; j++ )
+				sum += mTerms[i*n+j];
+			mSums[i] = sum;
+		}
+		mUpdates = 0;
+	}
+
+}
+
+
+
+/**
+ * Empty every slot.
+ */
+void AmacadFitnessCache::clear() {
+
+	unsigned int n = mIds.size();
+	mMotions.resize( n );
+	mVersions.assign( n, 0 );
+	mValid.assign( n, false );
+	mTerms.assign( n*n, 0 );
+	mSums.assign( n, 0 );
+	mUpdates = 0;
+
+}
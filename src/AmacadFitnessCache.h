@@ -0,0 +1,104 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __CLUSTERLIB_AMACADFITNESSCACHE_H_
+#define __CLUSTERLIB_AMACADFITNESSCACHE_H_
+
+#include <vector>
+#include <algorithm>
+
+
+/**
+ * The AMACAD F terms between each pair of cluster members.
+ *
+ * A CM's F value is its term with the CH plus the sum of its terms with
+ * every CM. The pairwise terms and their row sums are kept here, one slot
+ * per CM in ID order. Setting a slot's motion with a new data version
+ * redoes only that slot's row and column, and adjusts the other rows'
+ * sums by the difference.
+ */
+class AmacadFitnessCache {
+
+public:
+
+	/**
+	 * @brief What the F term is computed from.
+	 */
+	struct Motion {
+		double mX, mY;					/**< Position. */
+		double mSpeed;					/**< Speed. */
+		double mDestinationX;			/**< Destination. */
+		double mDestinationY;
+	};
+
+	AmacadFitnessCache();
+
+	/** Set the weights of the distance, speed and destination differences. */
+	void setWeights( double distance, double speed, double destination );
+
+	/** Weigh the distance, speed and destination differences between two nodes. */
+	double weigh( double distance, double speed, double destination ) const {
+		return distance * mWeights[0] + speed * mWeights[1] + destination * mWeights[2];
+	}
+
+	/** Calculate the F term between two nodes. */
+	double term( const Motion &a, const Motion &b ) const;
+
+	/** Does the cache hold exactly the CMs in the given ascending range of IDs? */
+	template<class Iterator> bool matches( Iterator first, Iterator last ) const {
+		return (unsigned int)std::distance( first, last ) == mIds.size() && std::equal( first, last, mIds.begin() );
+	}
+
+	/** Start again with the CMs in the given ascending range of IDs. Every slot must then be set. */
+	template<class Iterator> void assign( Iterator first, Iterator last ) {
+		mIds.clear();
+		for ( ; first != last; first++ )
+			mIds.push_back( *first );
+		clear();
+	}
+
+	/** Get the number of slots. */
+	unsigned int size() const { return mIds.size(); }
+
+	/** Get the ID of the CM in the given slot. */
+	unsigned int idOf( unsigned int slot ) const { return mIds[slot]; }
+
+	/** Get the slot of the CM with the given ID, or -1. */
+	int slotOf( unsigned int id ) const;
+
+	/** Set the motion of the CM in the given slot, unless its data version is unchanged. */
+	void set( unsigned int slot, const Motion &motion, unsigned int version );
+
+	/** Get the sum of the terms of the CM in the given slot with every other CM. */
+	double sum( unsigned int slot ) const { return mSums[slot]; }
+
+protected:
+
+	double mWeights[3];					/**< Weights of the distance, speed and destination differences. */
+	std::vector<unsigned int> mIds;		/**< ID of the CM in each slot, ascending. */
+	std::vector<Motion> mMotions;		/**< Motion of each CM when its terms were computed. */
+	std::vector<unsigned int> mVersions;	/**< Data version of each CM when its terms were computed. */
+	std::vector<char> mValid;			/**< Has each slot been set? */
+	std::vector<double> mTerms;			/**< Term between each pair of CMs, row-major. */
+	std::vector<double> mSums;			/**< Sum of each row of mTerms. */
+	unsigned int mUpdates;				/**< Rows updated since the sums were last recomputed in full. */
+
+	/** Empty every slot. */
+	void clear();
+
+};
+
+
+#endif
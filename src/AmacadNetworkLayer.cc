@@ -39,6 +39,7 @@ Define_Module(AmacadNetworkLayer);
 
 AmacadNetworkLayer::AmacadNetworkLayer() {
 	// TODO Auto-generated constructor stub
+	mDestinationStore = NULL;
 
 }
 
@@ -111,6 +112,7 @@ void AmacadNetworkLayer::initialize( int stage ) {
 		mClusterStartTime = 0;
 		mLastSpeed = mLastBandwidth = -1;
 		mCurrentState = Unclustered;
+		mLastDataVersion = 0;
 
 		// load configurations
 		mMinimumDensity = par("minimumDensity").longValue();
@@ -126,6 +128,7 @@ void AmacadNetworkLayer::initialize( int stage ) {
 		mWeights[0] = par("distanceWeight").doubleValue();
 		mWeights[1] = par("speedWeight").doubleValue();
 		mWeights[2] = par("destinationWeight").doubleValue();
+		mFitness.setWeights( mWeights[0], mWeights[1], mWeights[2] );
 
 
 		// set up self-messages
@@ -145,17 +148,17 @@ void AmacadNetworkLayer::initialize( int stage ) {
 		GetDestinationList();
 
 		// Schedule the change in destination.
-		scheduleAt( simTime() + mDestinationSet[0].mTime, mChangeDestinationMessage );
+		scheduleAt( simTime() + mDestinationSet.front().mTime, mChangeDestinationMessage );
 
 		// Schedule the "update mobility" signal
 		double diff = 1 + rand() / (double)RAND_MAX;
 		scheduleAt( simTime() + mTimeDifference * diff, mStartMessage );
 
 		// Set up the first destination.
-		mCurrentDestination = mDestinationSet[0].mDestination;
+		mCurrentDestination = mDestinationSet.front().mDestination;
 
 		// Clear the current destination in anticipation of the next one.
-		mDestinationSet.erase( mDestinationSet.begin() );
+		mDestinationSet.pop_front();
 
     }
 
@@ -184,6 +187,9 @@ void AmacadNetworkLayer::finish() {
         cancelEvent( mUpdateMobilityMessage );
     delete mUpdateMobilityMessage;
 
+    if ( mDestinationStore )
+        mDestinationStore->release();
+    mDestinationStore = NULL;
 
     ClusterAlgorithm::finish();
 
@@ -353,19 +359,7 @@ void AmacadNetworkLayer::handleLowerMsg( cMessage* m ) {
         		if ( mNeighbours.find(it->mId) == mNeighbours.end() || mNeighbours[it->mId].mLastHeard < it->mLastHeard ) {
 
         			// Either we done have the data, or we've been given a more recent entry.
-        			mNeighbours[it->mId].mId = it->mId;
-        			mNeighbours[it->mId].mNetworkAddress = it->mNetworkAddress;
-        			mNeighbours[it->mId].mPosition.x = it->mPositionX;
-        			mNeighbours[it->mId].mPosition.y = it->mPositionY;
-        			mNeighbours[it->mId].mSpeed = it->mSpeed;
-        			mNeighbours[it->mId].mDestination.x = it->mDestinationX;
-        			mNeighbours[it->mId].mDestination.y = it->mDestinationY;
-        			mNeighbours[it->mId].mIsClusterHead = it->mIsClusterHead;
-        			mNeighbours[it->mId].mClusterHead = it->mClusterHead;
-        			mNeighbours[it->mId].mNeighbourCount = it->mNeighbourCount;
-        			mNeighbours[it->mId].mClusterSize = it->mClusterSize;
-        			mNeighbours[it->mId].mValueF = CalculateF(it->mId);
-        			mNeighbours[it->mId].mLastHeard = it->mLastHeard;
+        			UpdateNeighbour( it->mId, *it );
 
         		}
 
@@ -434,19 +428,7 @@ void AmacadNetworkLayer::handleLowerMsg( cMessage* m ) {
 				if ( mNeighbours.find(mClusterHead) == mNeighbours.end() || mNeighbours[mClusterHead].mLastHeard < msg->getClusterTable()[0].mLastHeard ) {
 
 					// Either we done have the data, or we've been given a more recent entry.
-					mNeighbours[mClusterHead].mId = mClusterHead;
-					mNeighbours[mClusterHead].mNetworkAddress = msg->getClusterTable()[0].mNetworkAddress;
-					mNeighbours[mClusterHead].mPosition.x = msg->getClusterTable()[0].mPositionX;
-					mNeighbours[mClusterHead].mPosition.y = msg->getClusterTable()[0].mPositionY;
-					mNeighbours[mClusterHead].mSpeed = msg->getClusterTable()[0].mSpeed;
-					mNeighbours[mClusterHead].mDestination.x = msg->getClusterTable()[0].mDestinationX;
-					mNeighbours[mClusterHead].mDestination.y = msg->getClusterTable()[0].mDestinationY;
-					mNeighbours[mClusterHead].mIsClusterHead = msg->getClusterTable()[0].mIsClusterHead;
-					mNeighbours[mClusterHead].mClusterHead = msg->getClusterTable()[0].mClusterHead;
-					mNeighbours[mClusterHead].mNeighbourCount = msg->getClusterTable()[0].mNeighbourCount;
-					mNeighbours[mClusterHead].mClusterSize = msg->getClusterTable()[0].mClusterSize;
-					mNeighbours[mClusterHead].mValueF = CalculateF(mClusterHead);
-					mNeighbours[mClusterHead].mLastHeard = msg->getClusterTable()[0].mLastHeard;
+					UpdateNeighbour( mClusterHead, msg->getClusterTable()[0] );
 
 				}
 
@@ -526,19 +508,7 @@ void AmacadNetworkLayer::handleLowerMsg( cMessage* m ) {
             		if ( mNeighbours.find(it->mId) == mNeighbours.end() || mNeighbours[it->mId].mLastHeard < it->mLastHeard ) {
 
             			// Either we done have the data, or we've been given a more recent entry.
-            			mNeighbours[it->mId].mId = it->mId;
-            			mNeighbours[it->mId].mNetworkAddress = it->mNetworkAddress;
-            			mNeighbours[it->mId].mPosition.x = it->mPositionX;
-            			mNeighbours[it->mId].mPosition.y = it->mPositionY;
-            			mNeighbours[it->mId].mSpeed = it->mSpeed;
-            			mNeighbours[it->mId].mDestination.x = it->mDestinationX;
-            			mNeighbours[it->mId].mDestination.y = it->mDestinationY;
-            			mNeighbours[it->mId].mIsClusterHead = it->mIsClusterHead;
-            			mNeighbours[it->mId].mClusterHead = it->mClusterHead;
-            			mNeighbours[it->mId].mNeighbourCount = it->mNeighbourCount;
-            			mNeighbours[it->mId].mClusterSize = it->mClusterSize;
-            			mNeighbours[it->mId].mValueF = CalculateF(it->mId);
-            			mNeighbours[it->mId].mLastHeard = it->mLastHeard;
+            			UpdateNeighbour( it->mId, *it );
 
             		}
 
@@ -583,13 +553,13 @@ void AmacadNetworkLayer::handleSelfMsg(cMessage* msg) {
 			return;
 
 		// Trigger the change in destination.
-		scheduleAt( simTime() + mDestinationSet[0].mTime, mChangeDestinationMessage );
+		scheduleAt( simTime() + mDestinationSet.front().mTime, mChangeDestinationMessage );
 
 		// Set up the first destination.
-		mCurrentDestination = mDestinationSet[0].mDestination;
+		mCurrentDestination = mDestinationSet.front().mDestination;
 
 		// Clear the current destination in anticipation of the next one.
-		mDestinationSet.erase( mDestinationSet.begin() );
+		mDestinationSet.pop_front();
 		return;
 
 	} else {
@@ -1117,19 +1087,55 @@ void AmacadNetworkLayer::SendControlMessage( int type, int destID ) {
 void AmacadNetworkLayer::UpdateNeighbour( AmacadControlMessage *m ) {
 
 	int id = m->getNodeId();
-	mNeighbours[id].mId = id;
-	mNeighbours[id].mNetworkAddress = m->getSrcAddr();
-	mNeighbours[id].mPosition.x = m->getXPosition();
-	mNeighbours[id].mPosition.y = m->getYPosition();
-	mNeighbours[id].mSpeed = m->getSpeed();
-	mNeighbours[id].mDestination.x = m->getXDestination();
-	mNeighbours[id].mDestination.y = m->getYDestination();
-	mNeighbours[id].mIsClusterHead = m->getIsClusterHead();
-	mNeighbours[id].mClusterHead = m->getClusterHead();
-	mNeighbours[id].mNeighbourCount = m->getNeighbourCount();
-	mNeighbours[id].mClusterSize = m->getClusterSize();
-	mNeighbours[id].mValueF = CalculateF(id);
-	mNeighbours[id].mLastHeard = simTime();
+	Neighbour &n = SetNeighbourMotion( id, m->getXPosition(), m->getYPosition(), m->getSpeed(), m->getXDestination(), m->getYDestination() );
+	n.mId = id;
+	n.mNetworkAddress = m->getSrcAddr();
+	n.mIsClusterHead = m->getIsClusterHead();
+	n.mClusterHead = m->getClusterHead();
+	n.mNeighbourCount = m->getNeighbourCount();
+	n.mClusterSize = m->getClusterSize();
+	n.mValueF = CalculateF(id);
+	n.mLastHeard = simTime();
+
+}
+
+
+
+/**
+ * Update neighbour data with an entry of a received cluster table.
+ */
+void AmacadNetworkLayer::UpdateNeighbour( unsigned int id, const NeighbourEntry &e ) {
+
+	Neighbour &n = SetNeighbourMotion( id, e.mPositionX, e.mPositionY, e.mSpeed, e.mDestinationX, e.mDestinationY );
+	n.mId = id;
+	n.mNetworkAddress = e.mNetworkAddress;
+	n.mIsClusterHead = e.mIsClusterHead;
+	n.mClusterHead = e.mClusterHead;
+	n.mNeighbourCount = e.mNeighbourCount;
+	n.mClusterSize = e.mClusterSize;
+	n.mValueF = CalculateF(id);
+	n.mLastHeard = e.mLastHeard;
+
+}
+
+
+
+/**
+ * Set the position, speed and destination of a neighbour.
+ *
+ * Every write of these fields must come through here, as the new data
+ * version is what tells the fitness cache to recompute the neighbour's terms.
+ */
+AmacadNetworkLayer::Neighbour& AmacadNetworkLayer::SetNeighbourMotion( unsigned int id, double x, double y, double speed, double destX, double destY ) {
+
+	Neighbour &n = mNeighbours[id];
+	n.mPosition.x = x;
+	n.mPosition.y = y;
+	n.mSpeed = speed;
+	n.mDestination.x = destX;
+	n.mDestination.y = destY;
+	n.mDataVersion = ++mLastDataVersion;
+	return n;
 
 }
 
@@ -1156,34 +1162,39 @@ void AmacadNetworkLayer::CollectClusterHeadNeighbours() {
  */
 double AmacadNetworkLayer::CalculateF( int id ) {
 
-	double dL, dS, dD, ret = 0;
+	double ret = 0;
+	Coord myPos = mMobility->getCurrentPosition();
+	double mySpeed = mMobility->getCurrentSpeed().length();
 
 	if ( id != -1 ) {
 
 		// Compute the value of the given neighbour relative to our Cluster members.
 
 		// First put ours in.
-		dL = ( mNeighbours[id].mPosition - mMobility->getCurrentPosition() ).length();
-		dS = fabs( mNeighbours[id].mSpeed - mMobility->getCurrentSpeed().length() );
-		dD = ( mNeighbours[id].mDestination - mCurrentDestination ).length();
-		ret = dL * mWeights[0] + dS * mWeights[1] + dD * mWeights[2];
+		Neighbour &n = mNeighbours[id];
+		ret = CalculateFTerm( n.mPosition, n.mSpeed, n.mDestination, myPos, mySpeed, mCurrentDestination );
+
+		// Now add the terms for our CMs. These are cached if the node is a CM itself.
+		if ( mClusterMembers.find( id ) != mClusterMembers.end() ) {
+
+			UpdateFitnessCache();
+			ret += mFitness.sum( mFitness.slotOf( id ) );
+
+		} else {
+
+			for ( NodeIdSet::iterator it = mClusterMembers.begin(); it != mClusterMembers.end(); it++ ) {
+				Neighbour &cm = mNeighbours[*it];
+				ret += CalculateFTerm( n.mPosition, n.mSpeed, n.mDestination, cm.mPosition, cm.mSpeed, cm.mDestination );
+			}
 
-		// Now calculate it for our CMs.
-		for ( NodeIdSet::iterator it = mClusterMembers.begin(); it != mClusterMembers.end(); it++ ) {
-			dL = ( mNeighbours[id].mPosition - mNeighbours[*it].mPosition ).length();
-			dS = fabs( mNeighbours[id].mSpeed - mNeighbours[*it].mSpeed );
-			dD = ( mNeighbours[id].mDestination - mNeighbours[*it].mDestination ).length();
-			ret += dL * mWeights[0] + dS * mWeights[1] + dD * mWeights[2];
 		}
 
 	} else {
 
 		// Compute our F value.
 		for ( NodeIdSet::iterator it = mClusterMembers.begin(); it != mClusterMembers.end(); it++ ) {
-			dL = ( mNeighbours[*it].mPosition - mMobility->getCurrentPosition() ).length();
-			dS = fabs( mNeighbours[*it].mSpeed - mMobility->getCurrentSpeed().length() );
-			dD = ( mNeighbours[*it].mDestination - mCurrentDestination ).length();
-			ret += dL * mWeights[0] + dS * mWeights[1] + dD * mWeights[2];
+			Neighbour &cm = mNeighbours[*it];
+			ret += CalculateFTerm( cm.mPosition, cm.mSpeed, cm.mDestination, myPos, mySpeed, mCurrentDestination );
 		}
 
 	}
@@ -1194,6 +1205,40 @@ double AmacadNetworkLayer::CalculateF( int id ) {
 
 
 
+/**
+ * Calculate the F term between two nodes.
+ */
+double AmacadNetworkLayer::CalculateFTerm( const Coord &posA, double speedA, const Coord &destA, const Coord &posB, double speedB, const Coord &destB ) {
+
+	double dL = ( posA - posB ).length();
+	double dS = fabs( speedA - speedB );
+	double dD = ( destA - destB ).length();
+	return mFitness.weigh( dL, dS, dD );
+
+}
+
+
+
+/**
+ * Bring the fitness cache up to date with the CMs and their data.
+ */
+void AmacadNetworkLayer::UpdateFitnessCache() {
+
+	// If the set of CMs has changed, start again.
+	if ( !mFitness.matches( mClusterMembers.begin(), mClusterMembers.end() ) )
+		mFitness.assign( mClusterMembers.begin(), mClusterMembers.end() );
+
+	// Redo the terms of each CM whose data has changed.
+	for ( unsigned int k = 0; k < mFitness.size(); k++ ) {
+		Neighbour &a = mNeighbours[mFitness.idOf( k )];
+		AmacadFitnessCache::Motion m = { a.mPosition.x, a.mPosition.y, a.mSpeed, a.mDestination.x, a.mDestination.y };
+		mFitness.set( k, m, a.mDataVersion );
+	}
+
+}
+
+
+
 
 
 /**
@@ -1287,40 +1332,12 @@ void AmacadNetworkLayer::ChangeCH( int id ) {
  */
 void AmacadNetworkLayer::GetDestinationList() {
 
-	mDestinationSet.clear();
-
-	std::ifstream inputStream;
-	inputStream.open( par("destinationFile").stringValue() );
-	if ( inputStream.fail() )
-		throw cRuntimeError( "Cannot load the destination file." );
-
+	// The file is only parsed by the first module to ask for it.
+	mDestinationStore = DestinationStore::get( par("destinationFile").stringValue() );
 
 	TraCIMobility *mob = dynamic_cast<TraCIMobility*>(mMobility);
-	std::string carName, myName = mob->getExternalId();
-	int count;
-	DestinationEntry e;
-	int entryCount;
-	bool save;
-
-	inputStream >> entryCount;
-	for ( int i = 0; i < entryCount; i++ ) {
-
-		inputStream >> carName >> count;
-		save = ( carName == myName );
-		for ( int j = 0; j < count; j++ ) {
-
-			inputStream >> e.mTime >> e.mDestination.x >> e.mDestination.y;
-			if ( save )
-				mDestinationSet.push_back( e );
-
-		}
-
-		if ( save )
-			break;
-
-	}
-
-	inputStream.close();
+	if ( !mDestinationStore->getDestinations( mob->getExternalId(), mDestinationSet ) )
+		throw cRuntimeError( "No destinations for vehicle '%s' in the destination file.", mob->getExternalId().c_str() );
 
 }
 
@@ -20,6 +20,8 @@
 
 #include "ClusterAlgorithm.h"
 #include "AmacadControlMessage_m.h"
+#include "DestinationStore.h"
+#include "AmacadFitnessCache.h"
 
 class AmacadNetworkLayer: public ClusterAlgorithm {
 
@@ -69,13 +71,6 @@ protected:
 		Reclustering			/**< We're in the middle of a reclustering process. */
 	};
 
-	struct DestinationEntry {
-		double mTime;			/**< The time until which this is our destination. */
-		Coord mDestination;		/**< The coordinates of this destination. */
-	};
-
-	typedef std::vector<DestinationEntry> DestinationSet;
-
 	struct Neighbour {
 
 		int mId;							/**< ID of the node. */
@@ -90,6 +85,7 @@ protected:
 		int mClusterSize;				    /**< Size of this node's cluster, if CH. */
 
 		simtime_t mLastHeard;				/**< Time since we last heard from this node. */
+		unsigned int mDataVersion;			/**< Changes whenever the position, speed or destination changes. */
 
 	};
 
@@ -107,13 +103,28 @@ protected:
 
 	double mWeights[3];					/**< Set of weights. */
 	Coord mCurrentDestination;			/**< Current destination. */
-	DestinationSet mDestinationSet;		/**< Set of destinations. */
+	DestinationStore *mDestinationStore;	/**< Shared destination data. */
+	DestinationStore::Span mDestinationSet;	/**< Remaining destinations. */
 
 	double mLastSpeed;					/**< Last speed we calculated between our neighbours. */
 	double mLastBandwidth;				/**< Last bandwidth we calculated between our neighbours. */
 
 	int mCurrentClusterHeadTarget;		/**< The CH we're currently trying to affiliate with. */
 
+	/**
+	 * @name Fitness cache
+	 * @brief The F terms between each pair of CMs.
+	 *
+	 * Each neighbour's data version changes whenever its position, speed
+	 * or destination does, and tells the cache which CMs to redo.
+	 **/
+	/*@{*/
+
+	AmacadFitnessCache mFitness;				/**< Terms between each pair of CMs, and their row sums. */
+	unsigned int mLastDataVersion;				/**< Last data version given to a neighbour. */
+
+	/*@}*/
+
     /**
      * @name Handlers
      * @brief OMNeT++ message handler.
@@ -161,6 +172,18 @@ protected:
     void UpdateNeighbour( AmacadControlMessage *m );
 
 
+    /**
+     * Update neighbour data with an entry of a received cluster table.
+     */
+    void UpdateNeighbour( unsigned int id, const NeighbourEntry &e );
+
+
+    /**
+     * Set the position, speed and destination of a neighbour, giving its data a new version.
+     */
+    Neighbour& SetNeighbourMotion( unsigned int id, double x, double y, double speed, double destX, double destY );
+
+
     /**
      * Collect CH neighbours.
      */
@@ -173,6 +196,18 @@ protected:
     double CalculateF( int id=-1 );
 
 
+    /**
+     * Calculate the F term between two nodes.
+     */
+    double CalculateFTerm( const Coord &posA, double speedA, const Coord &destA, const Coord &posB, double speedB, const Coord &destB );
+
+
+    /**
+     * Bring the fitness cache up to date with the CMs and their data.
+     */
+    void UpdateFitnessCache();
+
+
     /**
      * Compute neighbour scores and return the ID of the best scoring one.
      */
@@ -45,7 +45,12 @@ void AmacadWeightCluster::initialize( int stage ) {
 
     MdmacNetworkLayer::initialize( stage );
     mIncludeDestination = true;
-	if ( stage == 1 ) {
+	if ( stage == 0 ) {
+
+		mDestinationStore = NULL;
+		mTermsValid = false;
+
+	} else if ( stage == 1 ) {
 
         mWeights[0] = par("distanceWeight").doubleValue();
         mWeights[1] = par("speedWeight").doubleValue();
@@ -56,13 +61,13 @@ void AmacadWeightCluster::initialize( int stage ) {
 
         // Schedule the change in destination.
         mChangeDestinationMessage = new cMessage( "changeDestination" );
-        scheduleAt( simTime() + mDestinationSet[0].mTime, mChangeDestinationMessage );
+        scheduleAt( simTime() + mDestinationSet.front().mTime, mChangeDestinationMessage );
 
         // Set up the first destination.
-        mCurrentDestination = mDestinationSet[0].mDestination;
+        mCurrentDestination = mDestinationSet.front().mDestination;
 
         // Clear the current destination in anticipation of the next one.
-        mDestinationSet.erase( mDestinationSet.begin() );
+        mDestinationSet.pop_front();
 
     }
 
@@ -80,13 +85,13 @@ void AmacadWeightCluster::handleSelfMsg(cMessage* msg) {
 				return;
 
 		// Trigger the change in destination.
-		scheduleAt( simTime() + mDestinationSet[0].mTime, mChangeDestinationMessage );
+		scheduleAt( simTime() + mDestinationSet.front().mTime, mChangeDestinationMessage );
 
 		// Set up the first destination.
-		mCurrentDestination = mDestinationSet[0].mDestination;
+		mCurrentDestination = mDestinationSet.front().mDestination;
 
 		// Clear the current destination in anticipation of the next one.
-		mDestinationSet.erase( mDestinationSet.begin() );
+		mDestinationSet.pop_front();
 
 		return;
 
@@ -105,6 +110,9 @@ void AmacadWeightCluster::finish() {
 	if ( mChangeDestinationMessage->isScheduled() )
 		cancelEvent( mChangeDestinationMessage );
 	delete mChangeDestinationMessage;
+	if ( mDestinationStore )
+		mDestinationStore->release();
+	mDestinationStore = NULL;
 	MdmacNetworkLayer::finish();
 
 }
@@ -115,61 +123,84 @@ void AmacadWeightCluster::finish() {
  */
 void AmacadWeightCluster::GetDestinationList() {
 
-	mDestinationSet.clear();
+	// The file is only parsed by the first module to ask for it.
+	mDestinationStore = DestinationStore::get( par("destinationFile").stringValue() );
 
-	std::ifstream inputStream;
-	inputStream.open( par("destinationFile").stringValue() );
-	if ( inputStream.fail() )
-		throw cRuntimeError( "Cannot load the destination file." );
+	TraCIMobility *mob = dynamic_cast<TraCIMobility*>(mMobility);
+	if ( !mDestinationStore->getDestinations( mob->getExternalId(), mDestinationSet ) )
+		throw cRuntimeError( "No destinations for vehicle '%s' in the destination file.", mob->getExternalId().c_str() );
 
+}
 
-	TraCIMobility *mob = dynamic_cast<TraCIMobility*>(mMobility);
-	std::string carName, myName = mob->getExternalId();
-	int count;
-	DestinationEntry e;
-	int entryCount;
-	bool save;
 
-	inputStream >> entryCount;
-	for ( int i = 0; i < entryCount; i++ ) {
 
-		inputStream >> carName >> count;
-		save = ( carName == myName );
-		for ( int j = 0; j < count; j++ ) {
+/** Add the destination data to a packet. */
+int AmacadWeightCluster::AddDestinationData( MdmacControlMessage *pkt ) {
 
-			inputStream >> e.mTime >> e.mDestination.x >> e.mDestination.y;
-			if ( save )
-				mDestinationSet.push_back( e );
+	pkt->setXDestination( mCurrentDestination.x );
+	pkt->setYDestination( mCurrentDestination.y );
+	return 128;
 
-		}
+}
 
-		if ( save )
-			break;
 
-	}
 
-	inputStream.close();
+/** Store the destination data from a packet. */
+void AmacadWeightCluster::StoreDestinationData( MdmacControlMessage *m ) {
+
+	int slot = mNeighbours.find( m->getNodeId() );
+	mNeighbours.mDestination[slot].x = m->getXDestination();
+	mNeighbours.mDestination[slot].y = m->getYDestination();
 
 }
 
 
 
-/** Add the destination data to a packet. */
-int AmacadWeightCluster::AddDestinationData( MdmacControlMessage *pkt ) {
+/** Recompute the weight term of a neighbour whose data has changed. */
+void AmacadWeightCluster::NeighbourUpdated( int slot ) {
 
-	pkt->setXDestination( mCurrentDestination.x );
-	pkt->setYDestination( mCurrentDestination.y );
-	return 128;
+	// Terms are computed against our state at the last refresh, so the total stays consistent.
+	if ( !mTermsValid )
+		return;
+
+	double dL = ( mTermPosition - mNeighbours.mPosition[slot] ).length();
+	double dS = ( mTermVelocity - mNeighbours.mVelocity[slot] ).length();
+	double dD = ( mTermDestination - mNeighbours.mDestination[slot] ).length();
+	mNeighbours.setTerm( slot, dL * mWeights[0] + dS * mWeights[1] + dD * mWeights[2] );
 
 }
 
 
 
-/** Store the destination data from a packet. */
-void AmacadWeightCluster::StoreDestinationData( MdmacControlMessage *m ) {
+/** Recompute the weight terms of all neighbours against our current state. */
+void AmacadWeightCluster::RefreshTerms( const Coord &p, const Coord &v ) {
+
+	mTermPosition = p;
+	mTermVelocity = v;
+	mTermDestination = mCurrentDestination;
+	mTermsValid = true;
+
+	// One pass over the contiguous slot arrays, written out per component so it vectorises.
+	unsigned int n = mNeighbours.size();
+	const Coord *pos = &mNeighbours.mPosition[0];
+	const Coord *vel = &mNeighbours.mVelocity[0];
+	const Coord *dst = &mNeighbours.mDestination[0];
+	double *term = &mNeighbours.mTerm[0];
+	double px = p.x, py = p.y, pz = p.z;
+	double vx = v.x, vy = v.y, vz = v.z;
+	double dx = mCurrentDestination.x, dy = mCurrentDestination.y, dz = mCurrentDestination.z;
+	double w0 = mWeights[0], w1 = mWeights[1], w2 = mWeights[2];
+
+	for ( unsigned int i = 0; i < n; i++ ) {
+		double ax = px - pos[i].x, ay = py - pos[i].y, az = pz - pos[i].z;
+		double bx = vx - vel[i].x, by = vy - vel[i].y, bz = vz - vel[i].z;
+		double cx = dx - dst[i].x, cy = dy - dst[i].y, cz = dz - dst[i].z;
+		term[i] = w0 * sqrt( ax*ax + ay*ay + az*az )
+				+ w1 * sqrt( bx*bx + by*by + bz*bz )
+				+ w2 * sqrt( cx*cx + cy*cy + cz*cz );
+	}
 
-	mNeighbours[m->getNodeId()].mDestination.x = m->getXDestination();
-	mNeighbours[m->getNodeId()].mDestination.y = m->getYDestination();
+	mNeighbours.sumTerms();
 
 }
 
@@ -183,14 +214,14 @@ double AmacadWeightCluster::calculateWeight() {
    	Coord p = mMobility->getCurrentPosition();
    	Coord v = mMobility->getCurrentSpeed();
 
-	double dL, dS, dD, ret = 0;
-    for ( NeighbourIterator it = mNeighbours.begin(); it != mNeighbours.end(); it++ ) {
-		dL = ( p - it->second.mPosition ).length();
-		dS = ( v - it->second.mVelocity ).length();
-		dD = ( mCurrentDestination - it->second.mDestination ).length();
-		ret += dL * mWeights[0] + dS * mWeights[1] + dD * mWeights[2];
-	}
+	// Our own motion changes every term, so only reuse the running total while we have not moved.
+	if ( !mTermsValid
+	  || p.x != mTermPosition.x || p.y != mTermPosition.y || p.z != mTermPosition.z
+	  || v.x != mTermVelocity.x || v.y != mTermVelocity.y || v.z != mTermVelocity.z
+	  || mCurrentDestination.x != mTermDestination.x || mCurrentDestination.y != mTermDestination.y
+	  || mCurrentDestination.z != mTermDestination.z )
+		RefreshTerms( p, v );
 
-	return -ret;
+	return -mNeighbours.termTotal();
 
 }
@@ -26,6 +26,7 @@
 
 #include "MdmacControlMessage_m.h"
 #include "MdmacNetworkLayer.h"
+#include "DestinationStore.h"
 
 
 /**
@@ -48,18 +49,28 @@ protected:
 	/** Get the destination from the destination file. */
 	void GetDestinationList();
 
-	struct DestinationEntry {
-		double mTime;                   /**< The time until which this is our destination. */
-		Coord mDestination;             /**< The coordinates of this destination. */
-	};
-
-	typedef std::vector<DestinationEntry> DestinationSet;
-
 	double mWeights[3];                     /**< Set of weights. */
-    DestinationSet mDestinationSet;         /**< Set of destinations. */
+	DestinationStore *mDestinationStore;	/**< Shared destination data. */
+	DestinationStore::Span mDestinationSet;	/**< Remaining destinations. */
 	cMessage *mChangeDestinationMessage;	/**< Message to change the destination. */
 	Coord mCurrentDestination;				/**< Current destination of the node. */
 
+	/**
+	 * @name Weight terms
+	 * @brief Our own state when the neighbours' weight terms were last computed.
+	 *
+	 * Each neighbour's term is kept in the neighbour table, which maintains
+	 * the running total. The terms are only valid for the state below, so
+	 * they are all recomputed in one pass whenever our own position, speed
+	 * or destination changes.
+	 */
+	/*@{*/
+	bool mTermsValid;						/**< Have the terms been computed yet? */
+	Coord mTermPosition;					/**< Our position. */
+	Coord mTermVelocity;					/**< Our velocity. */
+	Coord mTermDestination;					/**< Our destination. */
+	/*@}*/
+
 
 	/** Add the destination data to a packet. */
 	int AddDestinationData( MdmacControlMessage *pkt );
@@ -67,6 +78,12 @@ protected:
 	/** Store the destination data from a packet. */
 	void StoreDestinationData( MdmacControlMessage *m );
 
+	/** Recompute the weight term of a neighbour whose data has changed. */
+	void NeighbourUpdated( int slot );
+
+	/** Recompute the weight terms of all neighbours against our current state. */
+	void RefreshTerms( const Coord &p, const Coord &v );
+
 
 	/** @brief Compute the CH weight for this node. */
 	double calculateWeight();
@@ -0,0 +1,113 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "BloomFilter.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+
+/**
+ * Make a filter sized for the given number of IDs at the given false positive rate.
+ *
+ * If maxBits is non-zero and the filter would need more bits, it gets
+ * maxBits (rounded down to whole bytes) and the hash count that is best
+ * for that size, and its false positive rate is higher than asked.
+ */
+BloomFilter::BloomFilter( unsigned int capacity, double falsePositiveRate, unsigned int maxBits ) {
+
+	if ( capacity == 0 )
+		capacity = 1;
+	if ( falsePositiveRate <= 0 || falsePositiveRate >= 1 )
+		throw "BloomFilter: The false positive rate must be between 0 and 1!";
+
+	// Optimal size and hash count for n IDs at rate p: m = -n ln(p) / ln(2)^2, k = (m/n) ln(2).
+	double ln2 = log( 2.0 );
+	unsigned int bits = (unsigned int)ceil( -(double)capacity * log( falsePositiveRate ) / ( ln2 * ln2 ) );
+	bits = ( bits + 7 ) & ~7u;
+	if ( maxBits > 0 && bits > maxBits )
+		bits = std::max( 8u, maxBits & ~7u );
+	mBits.assign( bits, false );
+
+	mHashCount = (unsigned int)floor( (double)bits / capacity * ln2 + 0.5 );
+	if ( mHashCount < 1 )
+		mHashCount = 1;
+
+}
+
+
+
+/** Add an ID. */
+void BloomFilter::insert( unsigned int id ) {
+
+	if ( mBits.empty() )
+		return;
+
+	unsigned int h1, h2, m = mBits.size();
+	hash( id, h1, h2 );
+	for ( unsigned int i = 0; i < mHashCount; i++ )
+		mBits[( h1 + i * h2 ) % m] = true;
+
+}
+
+
+
+/** Check whether the ID may have been added. */
+bool BloomFilter::mayContain( unsigned int id ) const {
+
+	if ( mBits.empty() )
+		return false;
+
+	unsigned int h1, h2, m = mBits.size();
+	hash( id, h1, h2 );
+	for ( unsigned int i = 0; i < mHashCount; i++ )
+		if ( !mBits[( h1 + i * h2 ) % m] )
+			return false;
+	return true;
+
+}
+
+
+
+/** Get the two base hashes of an ID, which are combined to make the others. */
+void BloomFilter::hash( unsigned int id, unsigned int &h1, unsigned int &h2 ) {
+
+	// MurmurHash3's 32-bit finaliser, applied twice with different seeds.
+	unsigned int h = id;
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	h1 = h;
+
+	h ^= 0x9e3779b9u;
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	h2 = h | 1;		// Odd, so the probes don't collapse onto one bit.
+
+}
+
+
+
+std::ostream& operator<<( std::ostream& os, const BloomFilter& f ) {
+
+	return os << f.bitLength() << " bits, k = " << f.hashCount();
+
+}
@@ -0,0 +1,75 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __CLUSTERLIB_BLOOMFILTER_H_
+#define __CLUSTERLIB_BLOOMFILTER_H_
+
+#include <ostream>
+#include <vector>
+
+
+/**
+ * Fixed-size Bloom filter over node IDs, sent in place of a full list of
+ * cluster members when a compact summary is enough.
+ *
+ * The filter is sized when it is made, from the number of IDs it should
+ * hold and the false positive rate wanted at that load. mayContain()
+ * never misses an inserted ID, but may report IDs that were never
+ * inserted. The size and hash count travel with the filter, so the
+ * receiver needs no configuration of its own.
+ */
+class BloomFilter {
+
+public:
+
+	/** Number of bits used to send the size and hash count. */
+	static const unsigned int HEADER_BITS = 24;
+
+	/** Make an empty filter with no bits, which contains nothing. */
+	BloomFilter() : mHashCount(0) {}
+
+	/** Make a filter sized for the given number of IDs at the given false positive rate, with at most maxBits bits if non-zero. */
+	BloomFilter( unsigned int capacity, double falsePositiveRate, unsigned int maxBits = 0 );
+
+	/** Add an ID. */
+	void insert( unsigned int id );
+
+	/** Check whether the ID may have been added. */
+	bool mayContain( unsigned int id ) const;
+
+	/** Check whether the filter has no bits. */
+	bool empty() const { return mBits.empty(); }
+
+	/** Get the number of bits needed to send the filter. */
+	unsigned int bitLength() const { return empty() ? 0 : mBits.size() + HEADER_BITS; }
+
+	/** Get the number of hash functions. */
+	unsigned int hashCount() const { return mHashCount; }
+
+protected:
+
+	std::vector<bool> mBits;			/**< The filter bits. */
+	unsigned int mHashCount;			/**< Number of bits set per ID. */
+
+	/** Get the two base hashes of an ID, which are combined to make the others. */
+	static void hash( unsigned int id, unsigned int &h1, unsigned int &h2 );
+
+};
+
+
+std::ostream& operator<<( std::ostream& os, const BloomFilter& f );
+
+
+#endif
@@ -0,0 +1,56 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "BranchDepths.h"
+
+
+
+/** Set the depth of a member's branch. */
+void BranchDepths::set( int id, int depth ) {
+
+	std::pair<DepthMap::iterator,bool> r = mDepth.insert( DepthMap::value_type( id, depth ) );
+	if ( !r.second ) {
+		if ( r.first->second == depth )
+			return;
+		uncount( r.first->second );
+		r.first->second = depth;
+	}
+	mCount[depth]++;
+
+}
+
+
+
+/** Remove a member's branch. */
+void BranchDepths::erase( int id ) {
+
+	DepthMap::iterator it = mDepth.find( id );
+	if ( it == mDepth.end() )
+		return;
+	uncount( it->second );
+	mDepth.erase( it );
+
+}
+
+
+
+/** Remove one branch of the given depth from the histogram. */
+void BranchDepths::uncount( int depth ) {
+
+	CountMap::iterator it = mCount.find( depth );
+	if ( --it->second == 0 )
+		mCount.erase( it );
+
+}
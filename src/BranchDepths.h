@@ -0,0 +1,63 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __CLUSTERLIB_BRANCHDEPTHS_H_
+#define __CLUSTERLIB_BRANCHDEPTHS_H_
+
+#include <map>
+
+
+/**
+ * Depths of the branches below a CH in a cluster hierarchy, one per member.
+ *
+ * Alongside the depth of each member's branch, a histogram counts how many
+ * branches have each depth, so the deepest branch is always at the end of
+ * the histogram. Setting or removing a branch costs O(log n) rather than a
+ * scan of every member.
+ */
+class BranchDepths {
+
+public:
+
+	/** Set the depth of a member's branch. */
+	void set( int id, int depth );
+
+	/** Remove a member's branch. */
+	void erase( int id );
+
+	/** Check whether a member has a branch. */
+	bool contains( int id ) const { return mDepth.find( id ) != mDepth.end(); }
+
+	/** Remove all branches. */
+	void clear() { mDepth.clear(); mCount.clear(); }
+
+	/** Get the length of the longest branch, counting the link to the member, or 0 with no members. */
+	int maximum() const { return mCount.empty() ? 0 : mCount.rbegin()->first + 1; }
+
+protected:
+
+	typedef std::map<int,int> DepthMap;
+	typedef std::map<int,unsigned int> CountMap;
+
+	DepthMap mDepth;			/**< Depth of the branch of each member. */
+	CountMap mCount;			/**< Number of branches of each depth. */
+
+	/** Remove one branch of the given depth from the histogram. */
+	void uncount( int depth );
+
+};
+
+
+#endif
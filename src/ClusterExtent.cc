@@ -0,0 +1,117 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "ClusterExtent.h"
+
+
+
+/** Set the position of a member, adding it if it is not tracked. */
+void ClusterExtent::set( unsigned int id, const Coord &pos ) {
+
+	std::pair<SlotIndex::iterator,bool> r = mSlotIndex.insert( SlotIndex::value_type( id, mId.size() ) );
+	if ( r.second ) {
+		mId.push_back( id );
+		mX.push_back( pos.x );
+		mY.push_back( pos.y );
+	} else {
+		mX[r.first->second] = pos.x;
+		mY[r.first->second] = pos.y;
+	}
+
+}
+
+
+
+/** Update the position of a member. Returns false, doing nothing, if it is not tracked. */
+bool ClusterExtent::update( unsigned int id, const Coord &pos ) {
+
+	SlotIndex::iterator it = mSlotIndex.find( id );
+	if ( it == mSlotIndex.end() )
+		return false;
+	mX[it->second] = pos.x;
+	mY[it->second] = pos.y;
+	return true;
+
+}
+
+
+
+/** Stop tracking a member. */
+void ClusterExtent::erase( unsigned int id ) {
+
+	SlotIndex::iterator it = mSlotIndex.find( id );
+	if ( it == mSlotIndex.end() )
+		return;
+
+	// Fill the hole with the last entry so the arrays stay dense.
+	unsigned int slot = it->second;
+	unsigned int last = mId.size() - 1;
+	mSlotIndex.erase( it );
+	if ( slot != last ) {
+		mId[slot] = mId[last];
+		mX[slot] = mX[last];
+		mY[slot] = mY[last];
+		mSlotIndex[mId[slot]] = slot;
+	}
+	mId.pop_back();
+	mX.pop_back();
+	mY.pop_back();
+
+}
+
+
+
+/** Stop tracking all members. */
+void ClusterExtent::clear() {
+
+	mSlotIndex.clear();
+	mId.clear();
+	mX.clear();
+	mY.clear();
+
+}
+
+
+
+/** Find the members at the front and back of the cluster along the given heading. */
+bool ClusterExtent::edgeNodes( const Coord &heading, unsigned int &front, unsigned int &back ) const {
+
+	unsigned int n = mId.size();
+	if ( n < 2 || ( heading.x == 0 && heading.y == 0 ) )
+		return false;
+
+	// The heading needn't be normalised; only the order of the projections matters.
+	unsigned int iMax = 0, iMin = 0;
+	double pMax = mX[0] * heading.x + mY[0] * heading.y;
+	double pMin = pMax;
+	for ( unsigned int i = 1; i < n; i++ ) {
+		double p = mX[i] * heading.x + mY[i] * heading.y;
+		if ( p > pMax ) {
+			pMax = p;
+			iMax = i;
+		} else if ( p < pMin ) {
+			pMin = p;
+			iMin = i;
+		}
+	}
+
+	if ( !( pMax > pMin ) )
+		return false;
+
+	front = mId[iMax];
+	back = mId[iMin];
+	return true;
+
+}
@@ -0,0 +1,71 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __CLUSTERLIB_CLUSTEREXTENT_H_
+#define __CLUSTERLIB_CLUSTEREXTENT_H_
+
+#include <Coord.h>
+
+#include <vector>
+#include <map>
+
+
+/**
+ * Last known positions of the members of a cluster, used by a CH to find
+ * the two members at the front and back of the cluster.
+ *
+ * Positions are kept in dense coordinate arrays, updated as members join
+ * and leave and as their beacons arrive. The edge nodes along a heading
+ * are the members with the largest and smallest projection onto it, which
+ * one pass over the arrays finds.
+ */
+class ClusterExtent {
+
+public:
+
+	/** Set the position of a member, adding it if it is not tracked. */
+	void set( unsigned int id, const Coord &pos );
+
+	/** Update the position of a member. Returns false, doing nothing, if it is not tracked. */
+	bool update( unsigned int id, const Coord &pos );
+
+	/** Stop tracking a member. */
+	void erase( unsigned int id );
+
+	/** Stop tracking all members. */
+	void clear();
+
+	/** Get the number of tracked members. */
+	unsigned int size() const { return mId.size(); }
+
+	/**
+	 * Find the members at the front and back of the cluster along the given heading.
+	 * Returns false if there are no two members a non-zero distance apart along it.
+	 */
+	bool edgeNodes( const Coord &heading, unsigned int &front, unsigned int &back ) const;
+
+protected:
+
+	typedef std::map<unsigned int,unsigned int> SlotIndex;
+
+	SlotIndex mSlotIndex;				/**< Lookup of member ID to slot. */
+	std::vector<unsigned int> mId;		/**< ID of the member in each slot. */
+	std::vector<double> mX;				/**< X coordinate of each member. */
+	std::vector<double> mY;				/**< Y coordinate of each member. */
+
+};
+
+
+#endif
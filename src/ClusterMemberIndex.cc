@@ -0,0 +1,81 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "ClusterMemberIndex.h"
+
+
+
+/** Add a member. */
+void ClusterMemberIndex::insert( unsigned int id ) {
+
+	if ( id >= DENSE_LIMIT ) {
+		mSparse.insert( id );
+		return;
+	}
+
+	if ( id >= mDense.size() )
+		mDense.resize( id + 1, false );
+	mDense[id] = true;
+
+}
+
+
+
+/** Remove a member. */
+void ClusterMemberIndex::erase( unsigned int id ) {
+
+	if ( id >= DENSE_LIMIT )
+		mSparse.erase( id );
+	else if ( id < mDense.size() )
+		mDense[id] = false;
+
+}
+
+
+
+/** Remove all members. */
+void ClusterMemberIndex::clear() {
+
+	mDense.clear();
+	mSparse.clear();
+
+}
+
+
+
+/** Check whether any of the given IDs, which must be sorted in ascending order, is a member. */
+bool ClusterMemberIndex::intersects( const std::vector<unsigned int> &sortedIds ) const {
+
+	// The dense IDs come first; test each against the bitmap.
+	unsigned int i = 0, n = sortedIds.size();
+	unsigned int limit = mDense.size();
+	for ( ; i < n && sortedIds[i] < DENSE_LIMIT; i++ )
+		if ( sortedIds[i] < limit && mDense[sortedIds[i]] )
+			return true;
+
+	// Merge the rest against the sparse members, stopping at the first match.
+	std::set<unsigned int>::const_iterator it = mSparse.begin();
+	while ( i < n && it != mSparse.end() ) {
+		if ( sortedIds[i] < *it )
+			i++;
+		else if ( *it < sortedIds[i] )
+			it++;
+		else
+			return true;
+	}
+
+	return false;
+
+}
@@ -0,0 +1,66 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __CLUSTERLIB_CLUSTERMEMBERINDEX_H_
+#define __CLUSTERLIB_CLUSTERMEMBERINDEX_H_
+
+#include <vector>
+#include <set>
+
+
+/**
+ * Membership index of a cluster, for testing whether a list of node IDs
+ * received from another cluster has any member in common with ours.
+ *
+ * Node IDs are OMNeT++ module IDs, which are small and dense, so IDs
+ * below DENSE_LIMIT are kept as bits in a bitmap and tested in O(1).
+ * Any larger IDs go in a sorted set, which is merged against the tail of
+ * the received list.
+ */
+class ClusterMemberIndex {
+
+public:
+
+	/** IDs below this are kept in the bitmap. */
+	static const unsigned int DENSE_LIMIT = 65536;
+
+	/** Add a member. */
+	void insert( unsigned int id );
+
+	/** Remove a member. */
+	void erase( unsigned int id );
+
+	/** Remove all members. */
+	void clear();
+
+	/** Check whether the given node is a member. */
+	bool contains( unsigned int id ) const {
+		if ( id < DENSE_LIMIT )
+			return id < mDense.size() && mDense[id];
+		return mSparse.find( id ) != mSparse.end();
+	}
+
+	/** Check whether any of the given IDs, which must be sorted in ascending order, is a member. */
+	bool intersects( const std::vector<unsigned int> &sortedIds ) const;
+
+protected:
+
+	std::vector<bool> mDense;				/**< Bit per ID below DENSE_LIMIT, set for members. */
+	std::set<unsigned int> mSparse;			/**< Members with IDs from DENSE_LIMIT up. */
+
+};
+
+
+#endif
@@ -0,0 +1,104 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <omnetpp.h>
+#include <fstream>
+
+#include "DestinationStore.h"
+
+
+DestinationStore::StoreMap DestinationStore::msStores;
+
+
+
+/** Get the store for the given file, loading it if needed. Call release() when done with it. */
+DestinationStore* DestinationStore::get( const char *filename ) {
+
+	DestinationStore *store;
+	StoreMap::iterator it = msStores.find( filename );
+	if ( it == msStores.end() ) {
+		store = new DestinationStore( filename );
+		msStores[filename] = store;
+	} else {
+		store = it->second;
+	}
+
+	store->mReferenceCount++;
+	return store;
+
+}
+
+
+
+/** Release a store obtained from get(). */
+void DestinationStore::release() {
+
+	if ( --mReferenceCount > 0 )
+		return;
+
+	msStores.erase( mFilename );
+	delete this;
+
+}
+
+
+
+/** Get the destinations of the given vehicle. Returns false if the vehicle is not in the file. */
+bool DestinationStore::getDestinations( const std::string &vehicle, Span &span ) const {
+
+	VehicleIndex::const_iterator it = mIndex.find( vehicle );
+	if ( it == mIndex.end() || it->second.second == 0 )
+		return false;
+
+	const Entry *first = &mEntries[it->second.first];
+	span = Span( first, first + it->second.second );
+	return true;
+
+}
+
+
+
+/** Load the given file. */
+DestinationStore::DestinationStore( const char *filename ) : mFilename( filename ), mReferenceCount( 0 ) {
+
+	std::ifstream inputStream;
+	inputStream.open( filename );
+	if ( inputStream.fail() )
+		throw cRuntimeError( "Cannot load the destination file." );
+
+	std::string carName;
+	int count;
+	Entry e;
+	int entryCount;
+
+	inputStream >> entryCount;
+	for ( int i = 0; i < entryCount; i++ ) {
+
+		inputStream >> carName >> count;
+
+		// The first list given for a vehicle is the one used.
+		mIndex.insert( VehicleIndex::value_type( carName, std::make_pair( (unsigned int)mEntries.size(), (unsigned int)count ) ) );
+		for ( int j = 0; j < count; j++ ) {
+
+			inputStream >> e.mTime >> e.mDestination.x >> e.mDestination.y;
+			mEntries.push_back( e );
+
+		}
+
+	}
+
+	inputStream.close();
+
+}
@@ -0,0 +1,101 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __CLUSTERLIB_DESTINATIONSTORE_H_
+#define __CLUSTERLIB_DESTINATIONSTORE_H_
+
+#include <Coord.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+
+/**
+ * Process-wide store of the vehicle destination files used by AMACAD.
+ *
+ * Each file is parsed once, the first time a module asks for it, into one
+ * contiguous array of destinations with an index by vehicle name. Modules
+ * get a read-only span of their own destinations. The store is shared by
+ * reference counting, like LSUFData.
+ *
+ * File format: the number of vehicles, then for each vehicle its name, its
+ * number of destinations, and for each destination "time x y".
+ */
+class DestinationStore {
+
+public:
+
+	/**
+	 * @brief A destination of a vehicle.
+	 */
+	struct Entry {
+		double mTime;			/**< The time until which this is our destination. */
+		Coord mDestination;		/**< The coordinates of this destination. */
+	};
+
+	/**
+	 * @brief Read-only view of the remaining destinations of a vehicle.
+	 */
+	class Span {
+	public:
+		Span() : mBegin(NULL), mEnd(NULL) {}
+		Span( const Entry *begin, const Entry *end ) : mBegin(begin), mEnd(end) {}
+
+		/** Check whether there are no destinations left. */
+		bool empty() const { return mBegin == mEnd; }
+
+		/** Get the number of destinations left. */
+		unsigned int size() const { return mEnd - mBegin; }
+
+		/** Get the next destination. */
+		const Entry& front() const { return *mBegin; }
+
+		/** Move on to the following destination. */
+		void pop_front() { mBegin++; }
+
+	protected:
+		const Entry *mBegin;	/**< Next destination. */
+		const Entry *mEnd;		/**< End of the destinations. */
+	};
+
+	/** Get the store for the given file, loading it if needed. Call release() when done with it. */
+	static DestinationStore* get( const char *filename );
+
+	/** Release a store obtained from get(). */
+	void release();
+
+	/** Get the destinations of the given vehicle. Returns false if the vehicle is not in the file. */
+	bool getDestinations( const std::string &vehicle, Span &span ) const;
+
+protected:
+
+	typedef std::map<std::string,DestinationStore*> StoreMap;
+	typedef std::map<std::string,std::pair<unsigned int,unsigned int> > VehicleIndex;
+
+	std::string mFilename;				/**< File this store was loaded from. */
+	std::vector<Entry> mEntries;		/**< Destinations of all vehicles, one vehicle after another. */
+	VehicleIndex mIndex;				/**< Lookup of vehicle name to its first entry and entry count. */
+	unsigned int mReferenceCount;		/**< The number of modules currently referencing this store. */
+
+	static StoreMap msStores;			/**< Loaded stores, by file name. */
+
+	/** Load the given file. */
+	DestinationStore( const char *filename );
+
+};
+
+
+#endif
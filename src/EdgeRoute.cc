@@ -0,0 +1,155 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <algorithm>
+
+#include "EdgeRoute.h"
+#include "SumoNameTable.h"
+
+
+unsigned int SharedEdgeRoute::msNextVersion = 1;
+const EdgeRoute SharedEdgeRoute::msEmpty;
+
+
+
+/** Set the route from a list of SUMO edge names. */
+void EdgeRoute::assign( const std::list<std::string> &edges ) {
+
+	mEdges.clear();
+	mEdges.reserve( edges.size() );
+	for ( std::list<std::string>::const_iterator it = edges.begin(); it != edges.end(); it++ )
+		mEdges.push_back( SumoNameTable::intern( *it ) );
+	mCursor = 0;
+
+}
+
+
+
+/** Set the route to at most the first n remaining edges of another route. */
+void EdgeRoute::assign( const EdgeRoute &r, unsigned int n ) {
+
+	std::vector<unsigned int>::const_iterator first = r.mEdges.begin() + r.mCursor;
+	mEdges.assign( first, first + std::min( n, r.size() ) );
+	mCursor = 0;
+
+}
+
+
+
+/** Move the cursor forward to the given edge. Returns false, leaving the cursor alone, if it is not ahead of us. */
+bool EdgeRoute::advanceTo( unsigned int edge ) {
+
+	for ( unsigned int i = mCursor; i < mEdges.size(); i++ ) {
+		if ( mEdges[i] == edge ) {
+			mCursor = i;
+			return true;
+		}
+	}
+	return false;
+
+}
+
+
+
+/** Remove all edges. */
+void EdgeRoute::clear() {
+
+	mEdges.clear();
+	mCursor = 0;
+
+}
+
+
+
+/** Swap the contents of two routes. */
+void EdgeRoute::swap( EdgeRoute &r ) {
+
+	mEdges.swap( r.mEdges );
+	std::swap( mCursor, r.mCursor );
+
+}
+
+
+
+/** Count the consecutive edges this route has in common with another, from both cursors, up to max. */
+unsigned int EdgeRoute::commonPrefix( const EdgeRoute &r, unsigned int max ) const {
+
+	unsigned int n = std::min( max, std::min( size(), r.size() ) );
+	if ( n == 0 )
+		return 0;
+
+	const unsigned int *a = &mEdges[0] + mCursor;
+	const unsigned int *b = &r.mEdges[0] + r.mCursor;
+
+	unsigned int i = 0;
+	while ( i < n && a[i] == b[i] )
+		i++;
+	return i;
+
+}
+
+
+
+/** Make a new shared route from a list of SUMO edge names. */
+SharedEdgeRoute SharedEdgeRoute::create( const std::list<std::string> &edges ) {
+
+	EdgeRoute *route = new EdgeRoute();
+	route->assign( edges );
+
+	SharedEdgeRoute r;
+	r.mRoute.reset( route );
+	r.mVersion = msNextVersion++;
+	return r;
+
+}
+
+
+
+/** Get a non-zero hash of at most the first n remaining edges. */
+unsigned int EdgeRoute::hash( unsigned int n ) const {
+
+	// 32-bit FNV-1a over the edge IDs.
+	unsigned int h = 2166136261u;
+	n = std::min( n, size() );
+	for ( unsigned int i = 0; i < n; i++ ) {
+		unsigned int e = mEdges[mCursor+i];
+		for ( int b = 0; b < 4; b++ ) {
+			h ^= ( e >> (8*b) ) & 0xff;
+			h *= 16777619u;
+		}
+	}
+
+	// Zero is kept to mean "no route".
+	return h ? h : 1;
+
+}
+
+
+
+std::ostream& operator<<( std::ostream& os, const EdgeRoute& r ) {
+
+	for ( unsigned int i = 0; i < r.size(); i++ )
+		os << ( i ? ", " : "" ) << SumoNameTable::name( r[i] );
+	return os;
+
+}
+
+
+
+std::ostream& operator<<( std::ostream& os, const SharedEdgeRoute& r ) {
+
+	return os << "v" << r.version() << ": " << r.get();
+
+}
@@ -0,0 +1,126 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __CLUSTERLIB_EDGEROUTE_H_
+#define __CLUSTERLIB_EDGEROUTE_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <list>
+
+#include <boost/shared_ptr.hpp>
+
+
+/**
+ * A vehicle route stored as a contiguous array of interned edge IDs
+ * (see SumoNameTable), with a cursor marking the current edge.
+ *
+ * Edges behind the cursor have already been driven; size() and
+ * operator[] only see the edges from the cursor onwards.
+ */
+class EdgeRoute {
+
+public:
+
+	/** Number of bits used to encode one edge on the air. */
+	static const unsigned int EDGE_ID_BITS = 32;
+
+	EdgeRoute() : mCursor(0) {}
+
+	/** Set the route from a list of SUMO edge names. */
+	void assign( const std::list<std::string> &edges );
+
+	/** Set the route to at most the first n remaining edges of another route. */
+	void assign( const EdgeRoute &r, unsigned int n );
+
+	/** Get the number of edges from the cursor onwards. */
+	unsigned int size() const { return mEdges.size() - mCursor; }
+
+	/** Check whether there are no edges left. */
+	bool empty() const { return mCursor >= mEdges.size(); }
+
+	/** Get the index of the current edge, which only ever increases until the route is reassigned. */
+	unsigned int cursor() const { return mCursor; }
+
+	/** Get the i-th edge from the cursor. */
+	unsigned int operator[]( unsigned int i ) const { return mEdges[mCursor+i]; }
+
+	/** Move the cursor forward to the given edge. Returns false, leaving the cursor alone, if it is not ahead of us. */
+	bool advanceTo( unsigned int edge );
+
+	/** Remove all edges. */
+	void clear();
+
+	/** Swap the contents of two routes. */
+	void swap( EdgeRoute &r );
+
+	/** Count the consecutive edges this route has in common with another, from both cursors, up to max. */
+	unsigned int commonPrefix( const EdgeRoute &r, unsigned int max ) const;
+
+	/** Get a non-zero hash of at most the first n remaining edges. */
+	unsigned int hash( unsigned int n ) const;
+
+	/** Get the number of bits needed to send the remaining edges. */
+	unsigned int bitLength() const { return size() * EDGE_ID_BITS; }
+
+protected:
+
+	std::vector<unsigned int> mEdges;		/**< Interned IDs of the edges in the route. */
+	unsigned int mCursor;					/**< Index of the current edge. */
+
+};
+
+
+/**
+ * Shared handle to an immutable EdgeRoute.
+ *
+ * Copies of the handle point at the same route, so a route can be put
+ * in every packet (and in every duplicate of a broadcast) without copying
+ * its edges. Each route made with create() gets a new version number,
+ * so two handles with the same version hold the same route.
+ */
+class SharedEdgeRoute {
+
+public:
+
+	/** Make an empty route with version 0. */
+	SharedEdgeRoute() : mVersion(0) {}
+
+	/** Make a new shared route from a list of SUMO edge names. */
+	static SharedEdgeRoute create( const std::list<std::string> &edges );
+
+	/** Get the route. */
+	const EdgeRoute& get() const { return mRoute ? *mRoute : msEmpty; }
+
+	/** Get the version of the route. */
+	unsigned int version() const { return mVersion; }
+
+protected:
+
+	boost::shared_ptr<const EdgeRoute> mRoute;	/**< The route, or NULL if empty. */
+	unsigned int mVersion;						/**< Version of the route. */
+
+	static unsigned int msNextVersion;			/**< Version given to the next route created. */
+	static const EdgeRoute msEmpty;				/**< Returned by get() for an empty handle. */
+
+};
+
+
+std::ostream& operator<<( std::ostream& os, const EdgeRoute& r );
+std::ostream& operator<<( std::ostream& os, const SharedEdgeRoute& r );
+
+
+#endif
@@ -37,6 +37,7 @@
 #include "ClusterAnalysisScenarioManager.h"
 #include "ExtendedRmacNetworkLayer.h"
 #include "RMACData.h"
+#include "NodePrecedence.h"
 
 #include "UraeMacLayer.h"
 #include "CarMobility.h"
@@ -151,6 +152,10 @@ void ExtendedRmacNetworkLayer::ClusterStarted() {
 void ExtendedRmacNetworkLayer::ClusterMemberAdded( int id ) {
 
 	ClusterAlgorithm::ClusterMemberAdded(id);
+	mClusterMemberIndex.insert( id );
+	NeighbourIterator it = mNeighbours.find( id );
+	if ( it != mNeighbours.end() )
+		mClusterExtent.set( id, it->second.mPosition );
 	// TODO: Assess changes to hierarchy and propagate them.
 	NodeIdList record;
 	UpdateLevelOfMember( id, record, false );
@@ -163,6 +168,8 @@ void ExtendedRmacNetworkLayer::ClusterMemberAdded( int id ) {
 void ExtendedRmacNetworkLayer::ClusterMemberRemoved( int id ) {
 
 	ClusterAlgorithm::ClusterMemberRemoved(id);
+	mClusterMemberIndex.erase( id );
+	mClusterExtent.erase( id );
 	// Assess changes to hierarchy and propagate them.
 	NodeIdList record;
 	UpdateLevelOfMember( id, record, true );
@@ -187,6 +194,7 @@ void ExtendedRmacNetworkLayer::ClusterDied( int deathType ) {
 		Process();
 	}
 	mMaximumLevels = mCurrentLevels = 0;
+	mBranchDepths.clear();
 	if ( mPollTriggerMessage->isScheduled() )
 		cancelEvent( mPollTriggerMessage );
 	if ( mPollPeriodFinishedMessage->isScheduled() )
@@ -216,8 +224,11 @@ void ExtendedRmacNetworkLayer::initialize(int stage)
         ChannelAccess *channelAccess = FindModule<ChannelAccess*>::findSubModule(findHost());
         mZoneOfInterest = 2 * channelAccess->getConnectionManager( channelAccess->getParentModule() )->getMaxInterferenceDistance();
         mTransmitRangeSq = pow( mZoneOfInterest/2, 2 );
+        mNeighbourGrid.setCellSize( mZoneOfInterest/2 );
 
 		dynamic_cast<CarMobility*>(mMobility)->SetListener(this);
+		mThisRouteStale = true;
+		mRouteBroadcastsLeft = 0;
 
 //        // Get the route of this car.
 //		TraCIScenarioManager *pManager = TraCIScenarioManagerAccess().get();
@@ -235,8 +246,27 @@ void ExtendedRmacNetworkLayer::initialize(int stage)
         mPollInterval = par("pollInterval").doubleValue();
         mPollTimeout = par("pollTimeout").doubleValue();
         mMissedPingThreshold = par("missedPingThreshold").longValue();
+        mClusterSummaryRate = par("clusterSummaryFalsePositiveRate").doubleValue();
+        if ( mClusterSummaryRate < 0 || mClusterSummaryRate >= 1 )
+        	throw cRuntimeError( "clusterSummaryFalsePositiveRate must be in [0,1)!" );
+        if ( par("clusterSummaryMaxBits").longValue() < 0 )
+        	throw cRuntimeError( "clusterSummaryMaxBits must not be negative!" );
+        mClusterSummaryMaxBits = par("clusterSummaryMaxBits").longValue();
+        if ( !NeighbourSelection::parse( par("neighbourTablePriority").stdstringValue(), mNeighbourTablePriority ) )
+        	throw cRuntimeError( "Unknown neighbourTablePriority: %s", par("neighbourTablePriority").stringValue() );
+        mDeltaNeighbourTables = par("deltaNeighbourTables").boolValue();
         mRouteSimilarityThreshold = par("routeSimilarityThreshold").longValue();
+        mRouteBroadcasts = par("routeBroadcasts").longValue();
         mCriticalLossProbability = par("criticalLossProbability").doubleValue();
+        mLossScale = 0;
+        mLossTable = NULL;
+        if ( par("lossTableSpacing").doubleValue() > 0 ) {
+        	try {
+        		mLossTable = MarcumQTable::get( par("lossTableRange").doubleValue(), par("lossTableSpacing").doubleValue(), par("lossTableMaxError").doubleValue(), par("lossTableCacheDir").stdstringValue() );
+        	} catch( const char *e ) {
+        		throw cRuntimeError( "%s (lossTableSpacing = %g, lossTableMaxError = %g)", e, par("lossTableSpacing").doubleValue(), par("lossTableMaxError").doubleValue() );
+        	}
+        }
 
         // Setup messages
         // Phase 1 clustering messages
@@ -265,6 +295,7 @@ void ExtendedRmacNetworkLayer::initialize(int stage)
 //	scheduleAt( manager->getSimulationTime()-0.1, mPrepareForSimulationEnd );
 
       	mMaximumLevels = mCurrentLevels = 0;
+      	mBranchDepths.clear();
 	mReaffiliationCount = 0;
 
 		// set up result collection
@@ -328,6 +359,10 @@ void ExtendedRmacNetworkLayer::finish() {
     	cancelEvent( mClusterUnifyTimeoutMessage );
     delete mClusterUnifyTimeoutMessage;
 
+    if ( mLossTable )
+    	mLossTable->release();
+    mLossTable = NULL;
+
     ClusterAlgorithm::finish();
 
 }
@@ -528,14 +563,17 @@ void ExtendedRmacNetworkLayer::handleLowerMsg(cMessage* msg) {
         		break;	// Ignore this command if it's from a different CH.
         	}
 
-        	// Get the cluster member table out of the frame.
-        	mTemporaryClusterRecord.clear();
-        	//std::cerr << mId << ": Sending cluster presence message with cluster table: [";
-        	for ( NeighbourIdSetIterator it = m->getNeighbourIdTable().begin(); it != m->getNeighbourIdTable().end(); it++ ) {
-        		mTemporaryClusterRecord.insert(*it);
-        		//std::cerr << *it << " ";
+        	// Get the cluster member table or summary out of the frame.
+        	mClusterSummary = m->getClusterSummary();
+        	if ( mClusterSummary.empty() ) {
+	        	mTemporaryClusterRecord.clear();
+	        	//std::cerr << mId << ": Sending cluster presence message with cluster table: [";
+	        	for ( NeighbourIdSetIterator it = m->getNeighbourIdTable().begin(); it != m->getNeighbourIdTable().end(); it++ ) {
+	        		mTemporaryClusterRecord.insert(*it);
+	        		//std::cerr << *it << " ";
+	        	}
+	        	//std::cerr << "]\n";
         	}
-        	//std::cerr << "]\n";
 
         	BroadcastClusterPresence();
 
@@ -730,10 +768,13 @@ void ExtendedRmacNetworkLayer::handleSelfMsg(cMessage* msg) {
     	// Polling interval finished
     	// Check for nodes that have not responded
 		//std::cerr << mId << ": Poll Period finished!\n";
+    	UpdateLossProbabilities( mWaitingPollAcks );
     	for ( NodeIdSet::iterator it = mWaitingPollAcks.begin(); it != mWaitingPollAcks.end(); it++ ) {
 
 			// Increment the missed ping counter.
 			mNeighbours[*it].mMissedPings++;
+			if ( mDeltaNeighbourTables )
+				mNeighbourLog.touch( *it );
 
 			bool routeDiverged = false, highLossProb = false, tooManyMisses = false;
 
@@ -752,7 +793,7 @@ void ExtendedRmacNetworkLayer::handleSelfMsg(cMessage* msg) {
 
 			if ( routeDiverged || highLossProb || tooManyMisses ) {
 				// Remove from both the neighbour table and the cluster
-				mNeighbours.erase(*it);
+				RemoveNeighbour( *it );
 				ClusterMemberRemoved(*it);
 			}
 
@@ -874,9 +915,12 @@ bool ExtendedRmacNetworkLayer::Process( cMessage *msg ) {
 				} else {
 
 					// We have a set of one hop neighbours. Apply the ExtendedNPA.
-					ExtendedNPA predicate;
-					predicate.mClient = this;
-					std::sort( mOneHopNeighbours.begin(), mOneHopNeighbours.end(), predicate );
+					NodePrecedence npa( GetConnectionLimits(), GetDistanceThreshold(), GetTimeThreshold() );
+					for ( unsigned int i = 0; i < mOneHopNeighbours.size(); i++ ) {
+						const Neighbour &n = GetNeighbour( mOneHopNeighbours[i] );
+						npa.add( n.mId, n.mConnectionCount, n.mDistanceToNode, n.mLinkExpirationTime, n.mRouteSimilarity );
+					}
+					npa.rank( mOneHopNeighbours );
 					//std::cerr << mId << ": Have " << mOneHopNeighbours.size() << " 1-hop neighbours. Entering JOIN phase.\n";
 
 					// Now go to the joining phase.
@@ -917,7 +961,7 @@ bool ExtendedRmacNetworkLayer::Process( cMessage *msg ) {
 					//std::cerr << mId << ": JOIN timeout!\n";
 					// The JOIN timeout occurred. We must have gone out of range of this neighbour.
 					// We erase this from the neighbour table as well as the one-hop neighbours.
-					mNeighbours.erase( mOneHopNeighbours[0] );
+					RemoveNeighbour( mOneHopNeighbours[0] );
 					mOneHopNeighbours.erase( mOneHopNeighbours.begin() );
 				} else if ( msg == mJoinDenyMessage ) {
 					//std::cerr << mId << ": JOIN denied!\n";
@@ -953,6 +997,11 @@ bool ExtendedRmacNetworkLayer::Process( cMessage *msg ) {
 			    	// We haven't heard from the CH in a while. Let's check the connection with the CH.
 		    		// Increment the missed ping counter.
 		    		mNeighbours[mClusterHead].mMissedPings++;
+		    		if ( mDeltaNeighbourTables )
+		    			mNeighbourLog.touch( mClusterHead );
+		    		NodeIdSet head;
+		    		head.insert( mClusterHead );
+		    		UpdateLossProbabilities( head );
 
 					bool routeDiverged = false, highLossProb = false, tooManyMisses = false;
 					
@@ -991,7 +1040,7 @@ bool ExtendedRmacNetworkLayer::Process( cMessage *msg ) {
 						}
 						mClusterHead = -1;
 						mClusterHierarchy.clear();
-						mNeighbours.erase(mClusterHead);
+						RemoveNeighbour( mClusterHead );
 
 		    		} else {
 
@@ -1044,7 +1093,7 @@ void ExtendedRmacNetworkLayer::GetOneHopNeighbours() {
 bool ExtendedRmacNetworkLayer::EvaluateClusterPresence( ExtendedRmacControlMessage *m ) {
 
 	// First let's check if the sending node is in our cluster.
-	if ( ListHasValue( mClusterMembers, m->getNodeId() ) )
+	if ( mClusterMemberIndex.contains( m->getNodeId() ) )
 		return false;	// Connected cluster
 
 	//std::cerr << mId << ": Looking for intersection between [";
@@ -1056,11 +1105,18 @@ bool ExtendedRmacNetworkLayer::EvaluateClusterPresence( ExtendedRmacControlMessa
 		std::cerr << *it << " ";
 	std::cerr << "]\n";*/
 
-	// Check if there are any common neighbours.
-	NodeIdSet::iterator it = mClusterMembers.begin();
-	for ( it = mClusterMembers.begin(); it != mClusterMembers.end(); it++ )
-		if( ListHasValue( m->getNeighbourIdTable(), *it ) )
-			return false;
+	// Check if there are any common neighbours. A false positive from a summary makes the clusters look connected.
+	const BloomFilter &summary = m->getClusterSummary();
+	if ( !summary.empty() ) {
+		for ( NodeIdSet::iterator it = mClusterMembers.begin(); it != mClusterMembers.end(); it++ )
+			if ( summary.mayContain( *it ) )
+				return false;
+		return true;
+	}
+
+	// Senders fill the table from a set, so it is sorted.
+	if ( mClusterMemberIndex.intersects( m->getNeighbourIdTable() ) )
+		return false;
 
 	return true;
 
@@ -1108,28 +1164,51 @@ void ExtendedRmacNetworkLayer::SendControlMessage( int type, int id, int role )
 
     	coreEV << "POLL" << ( type == POLL_ACK_MESSAGE ? "_ACK" : "" );
 
-    	NeighbourEntrySet &pSet = pkt->getNeighbourTable();
-    	for ( NeighbourIterator it = mNeighbours.begin(); it != mNeighbours.end(); it++ ) {
+    	if ( mDeltaNeighbourTables ) {
+
+    		// Send only the changes since the version of our table the receiver has acknowledged.
+    		unsigned int base = mNeighbourLog.acknowledged( id );
+    		unsigned int version = base;
+    		NeighbourIdSet &removed = pkt->getRemovedNeighbours();
+    		s += 96;
+    		NeighbourChangeLog::const_iterator c = mNeighbourLog.changesAfter( base );
+    		for ( ; c != mNeighbourLog.end(); c++ ) {
+    			if ( s + 328 > 18496 )
+    				break;	// The receiver is only brought up to the last change that fits.
+    			if ( c->second.mRemoved ) {
+    				removed.push_back( c->second.mId );
+    				s += 8;
+    			} else if ( MapHasKey( mNeighbours, c->second.mId ) && RelaysNeighbour( mNeighbours[c->second.mId], id ) ) {
+    				AddNeighbourEntry( pkt, mNeighbours[c->second.mId] );
+    				s += 328;
+    			}
+    			version = c->first;
+    		}
+    		pkt->setTableBaseVersion( base );
+    		pkt->setTableVersion( version );
+    		pkt->setTableAckVersion( mNeighbourLog.received( id ) );
+    		mNeighbourLog.setSent( id );
+
+    	} else {
+
+	    	// Only the neighbours in the receiver's zone of interest are candidates.
+	    	// If the table doesn't fit, send the entries that matter most first.
+	    	NeighbourSelection selection( mNeighbourTablePriority );
+	    	Coord receiver = mNeighbours[id].mPosition;
+	    	std::vector<unsigned int> nearby;
+	    	mNeighbourGrid.withinRadius( receiver, mZoneOfInterest, nearby );
+	    	for ( unsigned int i = 0; i < nearby.size(); i++ ) {
+	    		NeighbourIterator it = mNeighbours.find( nearby[i] );
+	    		if ( RelaysNeighbour( it->second, id ) )
+	    			selection.add( it->first, SIMTIME_DBL( it->second.mTimeStamp ), it->second.mLinkExpirationTime, it->second.mHopCount, it->second.mPosition.distance( receiver ) );
+	    	}
+
+	    	std::vector<unsigned int> selected;
+	    	selection.select( selected, s < 18496 ? ( 18496 - s ) / 328 : 0 );
+	    	for ( unsigned int i = 0; i < selected.size(); i++ )
+	    		AddNeighbourEntry( pkt, mNeighbours[selected[i]] );
+	    	s += 328 * selected.size();
 
-    		if ( it->second.mId == id || it->second.mProviderId == id )
-				continue;
-			if ( it->second.mPosition.distance( mNeighbours[id].mPosition ) > mZoneOfInterest )
-				continue;
-    		NeighbourEntry e;
-    		e.mId = it->second.mId;
-    		e.mNetworkAddress = it->second.mNetworkAddress;
-    		e.mPositionX = it->second.mPosition.x;
-    		e.mPositionY = it->second.mPosition.y;
-    		e.mVelocityX = it->second.mVelocity.x;
-    		e.mVelocityY = it->second.mVelocity.y;
-            e.mConnectionCount = it->second.mConnectionCount;
-            e.mHopCount = it->second.mHopCount+1;
-            e.mMissedPings = it->second.mMissedPings;
-            e.mTimeStamp = it->second.mTimeStamp;
-            pSet.push_back(e);
-            s += 328;
-            if ( s + 328 > 18496 )
-            	break;
     	}
 
     	int sizeToAdd = 8 * ( mTemporaryClusterRecord.size() + mClusterHierarchy.size() + 1 );
@@ -1160,17 +1239,26 @@ void ExtendedRmacNetworkLayer::SendControlMessage( int type, int id, int role )
     	else
     		coreEV << "CLUS_PRES";
 
-    	int sizeToAdd = 8 * ( mTemporaryClusterRecord.size() + mClusterHierarchy.size() + 1 );
+    	// Send the summary in place of the member list if it's enabled.
+    	bool sendSummary = mClusterSummaryRate > 0 && !mClusterSummary.empty();
+    	int sizeToAdd = 8 * ( mClusterHierarchy.size() + 1 );
+    	if ( sendSummary )
+    		sizeToAdd += mClusterSummary.bitLength();
+    	else
+    		sizeToAdd += 8 * mTemporaryClusterRecord.size();
     	if ( s + sizeToAdd < 18496 ) {
 
     		s += sizeToAdd;
 
-    		// Add the cluster record
-    		NeighbourIdSet &pIdSet = pkt->getNeighbourIdTable();
-			NodeIdSet::iterator it = mTemporaryClusterRecord.begin();
-	        for ( NodeIdSet::iterator it = mTemporaryClusterRecord.begin(); it != mTemporaryClusterRecord.end(); it++ ) {
-	        	pIdSet.push_back(*it);
-	        }
+    		if ( sendSummary ) {
+    			pkt->setClusterSummary( mClusterSummary );
+    		} else {
+	    		// Add the cluster record, in ascending order as EvaluateClusterPresence expects.
+	    		NeighbourIdSet &pIdSet = pkt->getNeighbourIdTable();
+		        for ( NodeIdSet::iterator it = mTemporaryClusterRecord.begin(); it != mTemporaryClusterRecord.end(); it++ ) {
+		        	pIdSet.push_back(*it);
+		        }
+    		}
 
 	        // Add the list of CHs in the hierarchy to the packet.
 	        NodeIdList &pList = pkt->getClusterHierarchy();
@@ -1198,6 +1286,41 @@ void ExtendedRmacNetworkLayer::SendControlMessage( int type, int id, int role )
     }
     coreEV << " message...\n";
 
+    // Announce our route by version and hash. The links themselves are only
+    // sent when a receiver is not known to have them already.
+    const SharedEdgeRoute &route = GetRoute();
+    pkt->setRouteVersion( route.version() );
+    pkt->setRouteHash( mThisRouteHash );
+    s += 64;
+
+    bool sendRoute = false;
+    if ( id == -1 ) {
+    	for ( NeighbourIterator it = mNeighbours.begin(); it != mNeighbours.end(); it++ ) {
+    		if ( it->second.mHopCount != 1 )
+    			continue;
+    		sendRoute |= ( it->second.mRouteHashSent != mThisRouteHash );
+    		it->second.mRouteHashSent = mThisRouteHash;
+    	}
+    	// A neighbour that misses this broadcast never echoes our hash back, so
+    	// keep the links in the next few broadcasts as well.
+    	if ( sendRoute )
+    		mRouteBroadcastsLeft = mRouteBroadcasts;
+    	if ( mRouteBroadcastsLeft > 0 ) {
+    		sendRoute = true;
+    		mRouteBroadcastsLeft--;
+    	}
+    } else {
+    	sendRoute = ( mNeighbours[id].mRouteHashSent != mThisRouteHash );
+    	mNeighbours[id].mRouteHashSent = mThisRouteHash;
+    	pkt->setPeerRouteHash( mNeighbours[id].mRouteHash );
+    	s += 32;
+    }
+
+    if ( sendRoute ) {
+    	pkt->setNodeRoute( route );
+    	s += std::min( route.get().size(), mRouteSimilarityThreshold ) * EdgeRoute::EDGE_ID_BITS;
+    }
+
     pkt->setBitLength(s); // size of the control packet packet.
 
     if ( type == INQ_MESSAGE || type == INQ_RESPONSE_MESSAGE )
@@ -1220,7 +1343,6 @@ void ExtendedRmacNetworkLayer::SendControlMessage( int type, int id, int role )
     pkt->setClusterHead( mClusterHead );
     pkt->setConnectionCount( mClusterMembers.size() );
 
-    pkt->setNodeRoute( dynamic_cast<CarMobility*>(mMobility)->getRoute() );
 
     pkt->setSrcAddr(myNetwAddr);
     pkt->setDestAddr(netwAddr);
@@ -1327,35 +1449,30 @@ void ExtendedRmacNetworkLayer::OrderClusterPresenceBroadcast() {
 	mTemporaryClusterRecord = mClusterMembers;
 	mTemporaryClusterRecord.insert(mId);
 
+	// Summarise them for the edge nodes, if enabled and either smaller than the list
+	// itself or needed because the list would not fit in the frame.
+	mClusterSummary = BloomFilter();
+	if ( mClusterSummaryRate > 0 ) {
+		BloomFilter summary( mTemporaryClusterRecord.size(), mClusterSummaryRate, mClusterSummaryMaxBits );
+		unsigned int listBits = 8 * mTemporaryClusterRecord.size();
+		bool listFits = 360 + 8 * ( mClusterHierarchy.size() + 1 ) + listBits < 18496;
+		if ( summary.bitLength() < listBits || !listFits ) {
+			for ( NodeIdSet::iterator it = mTemporaryClusterRecord.begin(); it != mTemporaryClusterRecord.end(); it++ )
+				summary.insert( *it );
+			mClusterSummary = summary;
+		}
+	}
+
 	// First determine cluster edge nodes
-	NodeIdSet::iterator it1, it2;
-	std::vector<NodePair> checkedPairs;
 	NodePair best(-1,-1);
-	double maxDist = 0;
-	Coord v = mMobility->getCurrentSpeed();
-	v = v / v.length();
 
 	if ( mClusterMembers.size() > 1 ) {
 
-		// For each member in the cluster.
-		for ( it1 = mTemporaryClusterRecord.begin(); it1 != mTemporaryClusterRecord.end(); it1++ ) {
-
-			// Go through all the other members in the cluster.
-			for ( it2 = mTemporaryClusterRecord.begin(); it2 != mTemporaryClusterRecord.end(); it2++ ) {
-				if ( *it1 == *it2 || ListHasValue(checkedPairs,NodePair(*it1,*it2)) || ListHasValue(checkedPairs,NodePair(*it2,*it1)) )
-					continue;
-				checkedPairs.push_back(NodePair(*it1,*it2));
-				Coord ab = ( mNeighbours[*it1].mPosition - mNeighbours[*it2].mPosition );
-				double d = ( ab.x*v.x + ab.y*v.y );
-				if ( d > maxDist ) {
-					maxDist = d;
-					best = checkedPairs.back();
-				}
-			}
-
-		}
+		// The edge nodes are the members furthest forward and back along our heading.
+		mClusterExtent.set( mId, mMobility->getCurrentPosition() );
+		mClusterExtent.edgeNodes( mMobility->getCurrentSpeed(), best.first, best.second );
 
-	} else {
+	} else if ( !mClusterMembers.empty() ) {
 
 		best = NodePair( mId, *mClusterMembers.begin() );
 
@@ -1453,8 +1570,19 @@ void ExtendedRmacNetworkLayer::LeaveCluster() {
  */
 double ExtendedRmacNetworkLayer::CalculateLinkExpirationTime( Coord pos, Coord vel ) {
 
-    Coord p = mMobility->getCurrentPosition();
-    Coord v = mMobility->getCurrentSpeed();
+    return CalculateLinkExpirationTime( pos, vel, mMobility->getCurrentPosition(), mMobility->getCurrentSpeed() );
+
+}
+
+/**
+ * @brief Calculate the Link Expiration Time, given the position and velocity of this node.
+ * @param[in] pos Position of the target node.
+ * @param[in] vel Velocity of the target node.
+ * @param[in] p Position of this node.
+ * @param[in] v Velocity of this node.
+ * @return The time until the link expires.
+ */
+double ExtendedRmacNetworkLayer::CalculateLinkExpirationTime( const Coord &pos, const Coord &vel, const Coord &p, const Coord &v ) {
 
     double a = v.x - vel.x;
     double b = p.x - pos.x;
@@ -1468,33 +1596,67 @@ double ExtendedRmacNetworkLayer::CalculateLinkExpirationTime( Coord pos, Coord v
 
 
 /**
- * @brief Calculate the loss probability of a node.
+ * @brief Calculate the arguments of the Marcum Q function that gives the loss probability of a node.
  * @param[in] a Parameter A of the channel's Rice distribution.
  * @param[in] sigma Parameter Sigma of the channel's Rice distribution.
  * @param[in] d Distance from the neighbour to this node.
- * @return The probability that the last received message could have been lost.
+ * @param[out] qa First argument of the Marcum Q function.
+ * @param[out] qb Second argument of the Marcum Q function.
  */
 
-double ExtendedRmacNetworkLayer::CalculateLossProbability( double a, double sigma, double d ) {
-
-	// We need to obtain transmitter data. So get access to the scenario manager.
-	Urae::UraeData *urae = Urae::UraeData::GetSingleton();
+void ExtendedRmacNetworkLayer::CalculateLossArguments( double a, double sigma, double d, double &qa, double &qb ) {
 
-	double lambdaBy4PiSq = urae->GetLamdaBy4PiSq();
-	double rxSensitivity = urae->GetReceiverSensitivity();
-	double txPower = urae->GetTransmitPower();
-	double systemLoss = urae->GetSystemLoss();
+	// We need to obtain transmitter data. It doesn't change, so only ask the scenario manager once.
+	if ( mLossScale == 0 ) {
+		Urae::UraeData *urae = Urae::UraeData::GetSingleton();
+		mLossScale = urae->GetReceiverSensitivity() / ( urae->GetTransmitPower() * urae->GetLamdaBy4PiSq() );
+	}
 
 	// Now prepare some computations.
-	double arg1 = a / sigma;
-	double arg2 = ( rxSensitivity * d * d ) / ( txPower * lambdaBy4PiSq * sigma );
+	qa = a / sigma;
+	qb = mLossScale * d * d / sigma;
+
+}
 
-	// Compute the loss probability from the Rice CDF, which is the Marcum Q function.
-//	std::cerr << mId << ": a = " << a << "; sigma = " << sigma << "; arg2 = " << arg2 << "; S = " << rxSensitivity << "; ";
-//	std::cerr << "d = " << d << "; txPower = " << txPower << "; l4p2 = " << lambdaBy4PiSq << "; ";
-	double prob = 1 - MarcumQ( arg1, arg2 );
-//	std::cerr << "prob = " << prob << "; K = " << a*a / (2*sigma*sigma) << "; O = " << a*a + (2*sigma*sigma) << "; d = " << d << "\n";
-	return ( prob != prob ? 0 : prob );
+
+/**
+ * @brief Compute the loss probabilities of the given neighbours in one batch.
+ * @param[in] ids The neighbours to update.
+ */
+
+void ExtendedRmacNetworkLayer::UpdateLossProbabilities( const NodeIdSet &ids ) {
+
+	// Compute the loss probabilities from the Rice CDF, which is the Marcum Q function.
+	if ( mLossTable ) {
+		for ( NodeIdSet::const_iterator it = ids.begin(); it != ids.end(); it++ ) {
+			NeighbourIterator n = mNeighbours.find( *it );
+			if ( n == mNeighbours.end() )
+				continue;
+			double prob = 1 - mLossTable->lookup( n->second.mLossArgA, n->second.mLossArgB );
+			n->second.mLossProbability = ( prob != prob ? 0 : prob );
+		}
+		return;
+	}
+
+	std::vector<Neighbour*> targets;
+	std::vector<double> a, b;
+	for ( NodeIdSet::const_iterator it = ids.begin(); it != ids.end(); it++ ) {
+		NeighbourIterator n = mNeighbours.find( *it );
+		if ( n == mNeighbours.end() )
+			continue;
+		targets.push_back( &n->second );
+		a.push_back( n->second.mLossArgA );
+		b.push_back( n->second.mLossArgB );
+	}
+	if ( targets.empty() )
+		return;
+
+	std::vector<double> q( targets.size() );
+	MarcumQ1( &a[0], &b[0], &q[0], targets.size() );
+	for ( unsigned int i = 0; i < targets.size(); i++ ) {
+		double prob = 1 - q[i];
+		targets[i]->mLossProbability = ( prob != prob ? 0 : prob );
+	}
 
 }
 
@@ -1505,26 +1667,65 @@ double ExtendedRmacNetworkLayer::CalculateLossProbability( double a, double sigm
  * @return The number of consecutive route links this node has in common with ours.
  */
 
-int ExtendedRmacNetworkLayer::CalculateRouteSimilarity( Route &r ) {
+int ExtendedRmacNetworkLayer::CalculateRouteSimilarity( const SharedEdgeRoute &r ) {
 
-	const Route& thisRoute = dynamic_cast<CarMobility*>(mMobility)->getRoute();
-    Route::iterator it1 = r.begin();
-    Route::const_iterator it2 = thisRoute.begin();
-    unsigned int minLen = std::min( r.size(), thisRoute.size() );
+    return GetRoute().get().commonPrefix( r.get(), mRouteSimilarityThreshold );
 
-    unsigned int similarity = 0;
-    for ( ; similarity < std::min( minLen, mRouteSimilarityThreshold ); similarity++ ) {
+}
 
-    	if ( *it1 != *it2 )
-    		break;	// Reached a dissimilar route link, so bail out.
 
-    	// Increment the indices.
-    	it1++;
-    	it2++;
 
-    }
+/**
+ * @brief Get the route of this node.
+ * @return The route, converted from the mobility module the first time it is needed after each intersection.
+ */
+const SharedEdgeRoute& ExtendedRmacNetworkLayer::GetRoute() {
+
+	// Packets already sent keep the old route alive until they are deleted.
+	if ( mThisRouteStale ) {
+		mThisRoute = SharedEdgeRoute::create( dynamic_cast<CarMobility*>(mMobility)->getRoute() );
+		mThisRouteHash = mThisRoute.get().hash( mRouteSimilarityThreshold );
+		mThisRouteStale = false;
+	}
 
-    return similarity;
+	return mThisRoute;
+
+}
+
+
+
+/**
+ * @brief Update the route similarity of the node that sent a message.
+ * @param[in] m The message.
+ *
+ * The similarity is only recomputed when our route or the sender's has changed.
+ */
+
+void ExtendedRmacNetworkLayer::UpdateRouteSimilarity( ExtendedRmacControlMessage *m ) {
+
+	Neighbour &n = mNeighbours[m->getNodeId()];
+	const SharedEdgeRoute &route = GetRoute();
+
+	// Keep the links of their route if they were sent.
+	if ( m->getNodeRoute().version() != 0 ) {
+		n.mRoute = m->getNodeRoute();
+		n.mRouteHash = m->getRouteHash();
+	}
+
+	// If they have an old copy of our route, send it again next time.
+	if ( !LAddress::isL3Broadcast( m->getDestAddr() ) && m->getPeerRouteHash() != mThisRouteHash )
+		n.mRouteHashSent = m->getPeerRouteHash();
+
+	// Our copy of their route is out of date, so keep the old similarity until the links arrive.
+	if ( n.mRouteHash != m->getRouteHash() )
+		return;
+
+	if ( n.mSimilarityRouteVersion == n.mRoute.version() && n.mSimilarityOwnVersion == route.version() )
+		return;	// Neither route has changed.
+
+	n.mRouteSimilarity = CalculateRouteSimilarity( n.mRoute );
+	n.mSimilarityRouteVersion = n.mRoute.version();
+	n.mSimilarityOwnVersion = route.version();
 
 }
 
@@ -1535,57 +1736,91 @@ int ExtendedRmacNetworkLayer::CalculateRouteSimilarity( Route &r ) {
 void ExtendedRmacNetworkLayer::UpdateNeighbour( ExtendedRmacControlMessage *m ) {
 
 	int id = m->getNodeId();
-    mNeighbours[id].mId = id;
-    mNeighbours[id].mPosition.x = m->getXPosition();
-    mNeighbours[id].mPosition.y = m->getYPosition();
-    mNeighbours[id].mVelocity.x = m->getXVelocity();
-    mNeighbours[id].mVelocity.y = m->getYVelocity();
-    mNeighbours[id].mIsClusterHead = m->getIsClusterHead();
-    mNeighbours[id].mClusterHead = m->getClusterHead();
-    mNeighbours[id].mConnectionCount = m->getConnectionCount();
-    mNeighbours[id].mNetworkAddress = m->getSrcAddr();
-    mNeighbours[id].mHopCount = 1;
-    mNeighbours[id].mProviderId = id;
-    mNeighbours[id].mDistanceToNode = mMobility->getCurrentPosition().distance( mNeighbours[id].mPosition );
-    mNeighbours[id].mLinkExpirationTime = CalculateLinkExpirationTime( mNeighbours[id].mPosition, mNeighbours[id].mVelocity );
-    mNeighbours[id].mTimeStamp = simTime();
-    mNeighbours[id].mMissedPings = 0;
+	Coord ownPosition = mMobility->getCurrentPosition();
+	Coord ownVelocity = mMobility->getCurrentSpeed();
+
+	Neighbour &n = mNeighbours[id];
+    n.mId = id;
+    n.mPosition.x = m->getXPosition();
+    n.mPosition.y = m->getYPosition();
+    n.mVelocity.x = m->getXVelocity();
+    n.mVelocity.y = m->getYVelocity();
+    n.mIsClusterHead = m->getIsClusterHead();
+    n.mClusterHead = m->getClusterHead();
+    n.mConnectionCount = m->getConnectionCount();
+    n.mNetworkAddress = m->getSrcAddr();
+    n.mHopCount = 1;
+    n.mProviderId = id;
+    n.mDistanceToNode = ownPosition.distance( n.mPosition );
+    n.mLinkExpirationTime = CalculateLinkExpirationTime( n.mPosition, n.mVelocity, ownPosition, ownVelocity );
+    mNeighbourGrid.set( id, n.mPosition );
+    if ( mClusterMembers.find( id ) != mClusterMembers.end() )
+    	mClusterExtent.set( id, n.mPosition );
+    n.mTimeStamp = simTime();
+    n.mMissedPings = 0;
 
     // Compute the route similarity of this node.
-    Route &r = m->getNodeRoute();
-    mNeighbours[id].mRouteSimilarity = CalculateRouteSimilarity(r);
+    UpdateRouteSimilarity( m );
 
-    // Compute the loss probability of this node.
+    // Keep what we need to compute the loss probability of this node. It's only needed when the node misses a poll.
     UraeMacToNetwControlInfo *ctrlInfo = dynamic_cast<UraeMacToNetwControlInfo*>(m->getControlInfo());
-    mNeighbours[id].mLossProbability = CalculateLossProbability( ctrlInfo->getA(), ctrlInfo->getSigma(), mNeighbours[id].mDistanceToNode );
+    CalculateLossArguments( ctrlInfo->getA(), ctrlInfo->getSigma(), n.mDistanceToNode, n.mLossArgA, n.mLossArgB );
 
 //    std::cerr << mId << ": Similarity(" << id << ") = " << mNeighbours[id].mRouteSimilarity << "\n";
 
-    mNeighbours[id].mDataOwner = this;
+    n.mDataOwner = this;
+    if ( mDeltaNeighbourTables )
+    	mNeighbourLog.touch( id );
 
 	NeighbourEntrySet &pSet = m->getNeighbourTable();
 	if ( !pSet.empty() ) {
 
+		// A table sent in ID order that is not much smaller than ours is merged with ours in one pass.
+		// Otherwise each entry is looked up on its own.
+		bool merge = pSet.size() * 8 >= mNeighbours.size();
+		for ( unsigned int i = 1; merge && i < pSet.size(); i++ )
+			merge = pSet[i-1].mId < pSet[i].mId;
+
+		NeighbourIterator pos = mNeighbours.begin();
 		NeighbourEntrySetIterator it = pSet.begin();
 		for ( ; it != pSet.end(); it++ ) {
 
-			if ( MapHasKey( mNeighbours, it->mId ) && ( mNeighbours[it->mId].mTimeStamp > it->mTimeStamp || mNeighbours[it->mId].mHopCount < it->mHopCount ) )
+			bool known;
+			if ( merge ) {
+				while ( pos != mNeighbours.end() && pos->first < it->mId )
+					pos++;
+				known = pos != mNeighbours.end() && pos->first == it->mId;
+				if ( !known )
+					pos = mNeighbours.insert( pos, NeighbourTable::value_type( it->mId, Neighbour() ) );
+			} else {
+				std::pair<NeighbourIterator,bool> r = mNeighbours.insert( NeighbourTable::value_type( it->mId, Neighbour() ) );
+				pos = r.first;
+				known = !r.second;
+			}
+
+			Neighbour &e = pos->second;
+			if ( known && ( e.mTimeStamp > it->mTimeStamp || e.mHopCount < it->mHopCount ) )
 				continue;	// We have more recent or closer data than this.
-			mNeighbours[it->mId].mId = it->mId;
-			mNeighbours[it->mId].mNetworkAddress = it->mNetworkAddress;
-			mNeighbours[it->mId].mPosition.x = it->mPositionX;
-			mNeighbours[it->mId].mPosition.y = it->mPositionY;
-			mNeighbours[it->mId].mVelocity.x = it->mVelocityX;
-			mNeighbours[it->mId].mVelocity.y = it->mVelocityY;
-		    mNeighbours[it->mId].mIsClusterHead = it->mIsClusterHead;
-		    mNeighbours[it->mId].mClusterHead = it->mClusterHead;
-			mNeighbours[it->mId].mConnectionCount = it->mConnectionCount;
-			mNeighbours[it->mId].mHopCount = it->mHopCount+1;
-			mNeighbours[it->mId].mTimeStamp = it->mTimeStamp;
-			mNeighbours[it->mId].mMissedPings = it->mMissedPings;
-		    mNeighbours[it->mId].mProviderId = id;
-		    mNeighbours[it->mId].mDistanceToNode = mMobility->getCurrentPosition().distance( mNeighbours[it->mId].mPosition );
-		    mNeighbours[it->mId].mLinkExpirationTime = CalculateLinkExpirationTime( mNeighbours[it->mId].mPosition, mNeighbours[it->mId].mVelocity );
+			// The same entry relayed again by another CM is not a change worth sending on.
+			bool changed = !known || e.mTimeStamp < it->mTimeStamp || e.mHopCount != it->mHopCount+1 || e.mProviderId != (unsigned int)id;
+			e.mId = it->mId;
+			e.mNetworkAddress = it->mNetworkAddress;
+			e.mPosition.x = it->mPositionX;
+			e.mPosition.y = it->mPositionY;
+			e.mVelocity.x = it->mVelocityX;
+			e.mVelocity.y = it->mVelocityY;
+		    e.mIsClusterHead = it->mIsClusterHead;
+		    e.mClusterHead = it->mClusterHead;
+			e.mConnectionCount = it->mConnectionCount;
+			e.mHopCount = it->mHopCount+1;
+			e.mTimeStamp = it->mTimeStamp;
+			e.mMissedPings = it->mMissedPings;
+		    e.mProviderId = id;
+		    e.mDistanceToNode = ownPosition.distance( e.mPosition );
+		    e.mLinkExpirationTime = CalculateLinkExpirationTime( e.mPosition, e.mVelocity, ownPosition, ownVelocity );
+		    mNeighbourGrid.set( it->mId, e.mPosition );
+		    if ( mClusterMembers.find( it->mId ) != mClusterMembers.end() )
+		    	mClusterExtent.set( it->mId, e.mPosition );
 
 		    /*
 		     *  About route similarity: The neighbour table does not contain a route of node i, but the similarity
@@ -1595,70 +1830,81 @@ void ExtendedRmacNetworkLayer::UpdateNeighbour( ExtendedRmacControlMessage *m )
 		     *  Sui = min( Sni, Snu ) where Snu is the similarity between us and the node we got that data from.
 		     *  This is the minimum similarity that can be inferred.
 		     */
-		    mNeighbours[it->mId].mRouteSimilarity = std::min( mNeighbours[id].mRouteSimilarity, it->mRouteSimilarity );
+		    e.mRouteSimilarity = std::min( n.mRouteSimilarity, it->mRouteSimilarity );
+		    e.mSimilarityOwnVersion = 0;	// Not computed from the routes, so redo it when we hear from this node.
 
-		    mNeighbours[it->mId].mDataOwner = this;
+		    e.mDataOwner = this;
+		    if ( mDeltaNeighbourTables && changed )
+		    	mNeighbourLog.touch( it->mId );
 
 		}
 
 	}
 
-}
+	// Apply the removals in a delta table, and note what each side has received.
+	if ( mDeltaNeighbourTables && ( m->getKind() == POLL_MESSAGE || m->getKind() == POLL_ACK_MESSAGE ) ) {
 
+		NeighbourIdSet &removed = m->getRemovedNeighbours();
+		for ( NeighbourIdSetIterator it = removed.begin(); it != removed.end(); it++ ) {
+			// Only drop what we learnt through the sender.
+			NeighbourIterator n = mNeighbours.find( *it );
+			if ( n != mNeighbours.end() && n->second.mProviderId == (unsigned int)id && n->second.mHopCount > 1 )
+				RemoveNeighbour( *it );
+		}
 
+		// If the delta starts beyond what we have applied, we've missed some of it, so ask for the whole table.
+		if ( m->getTableBaseVersion() > mNeighbourLog.received( id ) )
+			mNeighbourLog.setReceived( id, 0 );
+		else
+			mNeighbourLog.setReceived( id, m->getTableVersion() );
+		mNeighbourLog.setAcknowledged( id, m->getTableAckVersion() );
 
+	}
 
-/**
- * @brief Sorting predicate for the Node Precidence Algorithm.
- *
- * This implements the sorting mechanism for the Node Precidence Algorithm.
- */
-bool ExtendedRmacNetworkLayer::ExtendedNPA::operator()( const int &id1, const int &id2 ) {
+}
 
-	const Neighbour &n = mClient->GetNeighbour( id1 );
-	const Neighbour &m = mClient->GetNeighbour( id2 );
 
-    // Does 'n' have higher route similarity than 'm'?
-    if ( n.mRouteSimilarity > m.mRouteSimilarity )
-        return true;    // 'n' has higher precidence.
-    else if ( n.mRouteSimilarity < m.mRouteSimilarity )
-    	return false;   // 'm' has higher precidence.
 
-    // Has 'm' reached its maximum connection limits?
-    if ( m.mConnectionCount == m.mDataOwner->GetConnectionLimits() )
-        return true;    // 'n' has higher precidence.
 
-    // Has 'n' reached its maximum connection limits?
-    if ( n.mConnectionCount == n.mDataOwner->GetConnectionLimits() )
-        return false;   // 'm' has higher precidence.
+void ExtendedRmacNetworkLayer::RemoveNeighbour( int id ) {
 
-    // Is the difference in distance between this node and the others greater than a certain threshold?
-    if ( fabs( n.mDistanceToNode - m.mDistanceToNode ) >= n.mDataOwner->GetDistanceThreshold() ) {
+	mNeighbours.erase( id );
+	mNeighbourGrid.erase( id );
+	if ( mDeltaNeighbourTables ) {
+		mNeighbourLog.remove( id );
+		mNeighbourLog.forgetPeer( id );
+	}
 
-        // Is 'n' closer than 'm'?
-        if ( n.mDistanceToNode < m.mDistanceToNode )
-            return true;    // 'n' has higher precidence.
-        else
-            return false;   // 'm' has higher precidence.
+}
 
-    }
 
-    // Is the difference in LET greater than a certain threshold?
-    if ( fabs( n.mLinkExpirationTime - m.mLinkExpirationTime ) >= n.mDataOwner->GetTimeThreshold() ) {
 
-        // Is 'n' going to be in range longer than 'm'?
-        if ( n.mLinkExpirationTime > m.mLinkExpirationTime )
-            return true;    // 'n' has higher precidence.
-        else
-            return false;   // 'm' has higher precidence.
-    }
+bool ExtendedRmacNetworkLayer::RelaysNeighbour( const Neighbour &n, int id ) {
 
+	if ( n.mId == (unsigned int)id || n.mProviderId == (unsigned int)id )
+		return false;
+	if ( n.mPosition.distance( mNeighbours[id].mPosition ) > mZoneOfInterest )
+		return false;
+	return true;
+
+}
 
-    // Does 'n' have a larger cluster than 'm'?
-    if ( n.mConnectionCount > m.mConnectionCount )
-        return true;    // 'n' has higher precidence.
 
-    return false;       // 'm' has higher precidence.
+
+void ExtendedRmacNetworkLayer::AddNeighbourEntry( ExtendedRmacControlMessage *pkt, const Neighbour &n ) {
+
+	NeighbourEntry e;
+	e.mId = n.mId;
+	e.mNetworkAddress = n.mNetworkAddress;
+	e.mPositionX = n.mPosition.x;
+	e.mPositionY = n.mPosition.y;
+	e.mVelocityX = n.mVelocity.x;
+	e.mVelocityY = n.mVelocity.y;
+	e.mConnectionCount = n.mConnectionCount;
+	e.mHopCount = n.mHopCount+1;
+	e.mMissedPings = n.mMissedPings;
+	e.mTimeStamp = n.mTimeStamp;
+	pkt->getNeighbourTable().push_back(e);
 
 }
 
@@ -1670,22 +1916,21 @@ void ExtendedRmacNetworkLayer::UpdateLevelOfMember( int id, NodeIdList& record,
 	if ( ListHasValue( record, mId ) )
 		return;	// CYCLICAL CLUSTER STRUCTURE!
 
-	if ( !IsClusterHead() || !ListHasValue( mClusterMembers, id ) )
+	// A departing member has already left mClusterMembers, so look for its branch instead.
+	if ( !IsClusterHead() || !( eraseThis ? mBranchDepths.contains( id ) : mClusterMemberIndex.contains( id ) ) )
 		return;
 
-	// Assess changes to hierarchy and propagate them.
+	// Assess changes to hierarchy, and propagate them only if our longest branch changed.
 	ExtendedRmacNetworkLayer *p;
 	if ( eraseThis ) {
-		mLevelLookup.erase(id);
+		mBranchDepths.erase(id);
 	} else {
 		p = dynamic_cast<ExtendedRmacNetworkLayer*>( cSimulation::getActiveSimulation()->getModule( id ) );
-		mLevelLookup[id] = p->GetCurrentLevelCount();
-	}
-	mMaximumLevels = 0;
-	std::map<int,int>::iterator it;
-	for ( AllInVector( it, mLevelLookup ) ) {
-		mMaximumLevels = std::max( mMaximumLevels, it->second+1 );
+		mBranchDepths.set( id, p->GetCurrentLevelCount() );
 	}
+	if ( mBranchDepths.maximum() == mMaximumLevels )
+		return;
+	mMaximumLevels = mBranchDepths.maximum();
 
 	mCurrentLevels = std::max( mMaximumLevels, mCurrentLevels );
 
@@ -1717,6 +1962,9 @@ void ExtendedRmacNetworkLayer::LaneChanged( int newLane ) {
 
 void ExtendedRmacNetworkLayer::CrossedIntersection( std::string roadId ) {
 
+	// Our route in the mobility module has moved on.
+	mThisRouteStale = true;
+
 	// Go through all the neighbours and decrement the route similarity value.
 	for ( NeighbourIterator it = mNeighbours.begin(); it != mNeighbours.end(); it++ )
 		it->second.mRouteSimilarity -= ( it->second.mRouteSimilarity == 0 ? 0 : 1 );
@@ -20,6 +20,15 @@
 
 #include "CarMobility.h"
 #include "ClusterAlgorithm.h"
+#include "ClusterExtent.h"
+#include "ClusterMemberIndex.h"
+#include "BloomFilter.h"
+#include "NeighbourChangeLog.h"
+#include "NeighbourSelection.h"
+#include "BranchDepths.h"
+#include "NeighbourGrid.h"
+#include "MarcumQTable.h"
+#include "EdgeRoute.h"
 
 /**
  * This module implements the clustering mechanism for Robust
@@ -78,6 +87,13 @@ public:
         double mLinkExpirationTime;         	/**< Time until this link expires due to mobility. */
         int mMissedPings;						/**< Number of times this neighbour has missed a ping. */
         unsigned int mRouteSimilarity;			/**< How similar this node's route is to ours. */
+        SharedEdgeRoute mRoute;					/**< Last route received from this node. */
+        unsigned int mRouteHash;				/**< Hash of the route this node last announced. */
+        unsigned int mRouteHashSent;			/**< Hash of our route that this node is believed to hold. */
+        unsigned int mSimilarityRouteVersion;	/**< Version of mRoute that mRouteSimilarity was computed from. */
+        unsigned int mSimilarityOwnVersion;		/**< Version of our route that mRouteSimilarity was computed from. */
+        double mLossArgA;						/**< First argument of the Marcum Q function giving mLossProbability. */
+        double mLossArgB;						/**< Second argument of the Marcum Q function giving mLossProbability. */
         double mLossProbability;				/**< The probability that the last message received from this node could have been lost. */
         ExtendedRmacNetworkLayer *mDataOwner;	/**< Owner of this data. */
     };
@@ -302,14 +318,32 @@ protected:
     double CalculateLinkExpirationTime( Coord pos, Coord vel );
 
     /**
-     * @brief Calculate the loss probability of a node.
+     * @brief Calculate the Link Expiration Time, given the position and velocity of this node.
+     * @param[in] pos Position of the target node.
+     * @param[in] vel Velocity of the target node.
+     * @param[in] p Position of this node.
+     * @param[in] v Velocity of this node.
+     * @return The time until the link expires.
+     */
+    double CalculateLinkExpirationTime( const Coord &pos, const Coord &vel, const Coord &p, const Coord &v );
+
+    /**
+     * @brief Calculate the arguments of the Marcum Q function that gives the loss probability of a node.
      * @param[in] a Parameter A of the channel's Rice distribution.
      * @param[in] sigma Parameter Sigma of the channel's Rice distribution.
-     * @param[in] dSq Square of distance from the neighbour to this node.
-     * @return The probability that the last received message could have been lost.
+     * @param[in] d Distance from the neighbour to this node.
+     * @param[out] qa First argument of the Marcum Q function.
+     * @param[out] qb Second argument of the Marcum Q function.
+     */
+
+    void CalculateLossArguments( double a, double sigma, double d, double &qa, double &qb );
+
+    /**
+     * @brief Compute the loss probabilities of the given neighbours in one batch.
+     * @param[in] ids The neighbours to update.
      */
 
-    double CalculateLossProbability( double a, double sigma, double dSq );
+    void UpdateLossProbabilities( const NodeIdSet &ids );
 
 
     /**
@@ -318,7 +352,27 @@ protected:
      * @return The number of consecutive route links this node has in common with ours.
      */
 
-    int CalculateRouteSimilarity( Route &r );
+    int CalculateRouteSimilarity( const SharedEdgeRoute &r );
+
+
+
+    /**
+     * @brief Get the route of this node.
+     * @return The route, converted from the mobility module the first time it is needed after each intersection.
+     */
+
+    const SharedEdgeRoute& GetRoute();
+
+
+
+    /**
+     * @brief Update the route similarity of the node that sent a message.
+     * @param[in] m The message.
+     *
+     * The similarity is only recomputed when our route or the sender's has changed.
+     */
+
+    void UpdateRouteSimilarity( ExtendedRmacControlMessage *m );
 
 
 
@@ -327,6 +381,21 @@ protected:
      */
     void UpdateNeighbour( ExtendedRmacControlMessage *m );
 
+    /**
+     * Erase a neighbour from the table, logging the removal for delta tables.
+     */
+    void RemoveNeighbour( int id );
+
+    /**
+     * Check whether a neighbour is of interest to the given node, and so goes in the tables sent to it.
+     */
+    bool RelaysNeighbour( const Neighbour &n, int id );
+
+    /**
+     * Add a neighbour to the table in a frame.
+     */
+    void AddNeighbourEntry( ExtendedRmacControlMessage *pkt, const Neighbour &n );
+
     /*@}*/
 
 
@@ -342,7 +411,10 @@ protected:
 
     bool mInitialised;              /**< Set to true if the init function has been called. */
 
-//    Route mThisRoute;				/**< The route of this node. */
+    SharedEdgeRoute mThisRoute;		/**< The route of this node, shared with the packets that carry it. */
+    unsigned int mThisRouteHash;	/**< Hash of the links of mThisRoute that are compared. */
+    bool mThisRouteStale;			/**< Set when mThisRoute must be fetched again from the mobility module. */
+    unsigned int mRouteBroadcastsLeft;	/**< Number of further broadcasts that carry the links of our route. */
 
     /**
      * @name Messages
@@ -386,8 +458,15 @@ protected:
     double mPollInterval;					/**< Period for CHs polling  */
     double mPollTimeout;					/**< If a CM doesn't hear a POLL from the CH in this time, it departs the cluster. */
     unsigned int mMissedPingThreshold;		/**< Number of pings a node will miss before it is considered gone. */
+    double mClusterSummaryRate;				/**< False positive rate of the cluster summary in CLUS_PRES frames, or 0 to send the full member list. */
+    unsigned int mClusterSummaryMaxBits;	/**< Largest cluster summary to send, in bits, or 0 for no limit. */
+    NeighbourSelection::Priority mNeighbourTablePriority;	/**< Entries to send first when the neighbour table does not fit in a frame. */
+    bool mDeltaNeighbourTables;				/**< Send only the changed neighbour table entries in POLL and POLL_ACK frames. */
     unsigned int mRouteSimilarityThreshold;	/**< Number of links in a route that will be compared. */
+    unsigned int mRouteBroadcasts;			/**< Number of broadcasts that carry the links of our route after a neighbour is found to lack them. */
     double mCriticalLossProbability;		/**< The highest loss probability before a CM connection is considered dead. */
+    MarcumQTable *mLossTable;				/**< Table to interpolate loss probabilities from, or NULL to compute them. */
+    double mLossScale;						/**< Receiver sensitivity / ( transmit power * (lambda/4pi)^2 ), or 0 if not read yet. */
 
     /*@}*/
 
@@ -412,17 +491,14 @@ protected:
 
 	/*@}*/
 
-    /**
-     * This implements the sorting mechanism for the Node Precidence Algorithm.
-     */
-    struct ExtendedNPA {
-    	bool operator()( const int&, const int& );
-    	ExtendedRmacNetworkLayer *mClient;
-    };
-
     NodeIdSet mTemporaryClusterRecord;		/**< When a node receives a SEND_CLUSTER_PRESENCE_MESSAGE, it stores the cluster member record here. */
+    ClusterExtent mClusterExtent;			/**< Positions of the cluster members, used to find the edge nodes. */
+    ClusterMemberIndex mClusterMemberIndex;	/**< Index of the cluster members, used to test for common members. */
+    BloomFilter mClusterSummary;			/**< Summary of the cluster members to send in CLUS_PRES frames. */
+    NeighbourChangeLog mNeighbourLog;		/**< Changes to the neighbour table, used to send delta tables. */
+    NeighbourGrid mNeighbourGrid;			/**< Positions of the neighbours, used to find those near a node. */
     NodeIdList mClusterHierarchy;			/**< List of heads of clusters within the hierarchy. This is used to prevent cyclical clusters. */
-    std::map<int,int> mLevelLookup;			/**< Lookup table of node IDs and the corresponding depth of their branches in the hierarchy. */
+    BranchDepths mBranchDepths;				/**< Depths of the branches of the hierarchy below each member. */
     int mMaximumLevels;						/**< Length of the longest branch at this point in the hierarchy. */
     int mCurrentLevels;						/**< The largest length this cluster has ever reached. */
 
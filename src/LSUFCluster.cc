@@ -51,6 +51,9 @@ void LSUFCluster::initialize( int stage ) {
         }
 
         LSUFCluster::mLaneWeightData->addRef();
+        mBucketsValid = false;
+        mBucketPositionTolerance = par("bucketPositionTolerance").doubleValue();
+        mBucketVelocityTolerance = par("bucketVelocityTolerance").doubleValue();
 
     }
 
@@ -76,6 +79,61 @@ void LSUFCluster::finish() {
 }
 
 
+/** Recompute every neighbour's terms against our current state and rebuild the buckets. */
+void LSUFCluster::RebuildBuckets( const Coord &pos, const Coord &vel ) {
+
+	mBucketsValid = true;
+	mBucketRoad = mRoadID;
+	mBucketPosition = pos;
+	mBucketVelocity = vel;
+
+	mBuckets.clearSums();
+	for ( unsigned int i = 0; i < mNeighbours.size(); i++ )
+		SetBucket( i, mBuckets.flowOf( i ) );
+
+}
+
+
+
+/** Look up the flow of a neighbour whose data has changed and update its bucket. */
+void LSUFCluster::NeighbourUpdated( int slot ) {
+
+	unsigned char flow = LSUFCluster::mLaneWeightData->getLaneWeight( mNeighbours.mInfo[slot].mLaneID ).mFlowID;
+
+	// Until the first rebuild there are no buckets to keep up to date.
+	if ( mBucketsValid )
+		SetBucket( slot, flow );
+	else
+		mBuckets.set( slot, flow, false, 0, 0 );
+
+}
+
+
+
+/** Compute the terms of the neighbour in the given slot against our state at the last rebuild. */
+void LSUFCluster::SetBucket( int slot, unsigned char flow ) {
+
+	// This check does not appear to be part of the original algorithm.
+	// We don't want to cluster with cars that are not on the same road as us.
+	bool onRoad = mNeighbours.mInfo[slot].mRoadID == mBucketRoad;
+	float dist = mBucketPosition.distance( mNeighbours.mPosition[slot] );
+	float dv = mBucketVelocity.distance( mNeighbours.mVelocity[slot] );
+	mBuckets.set( slot, flow, onRoad, dist, dv );
+
+}
+
+
+
+/** Take an expiring neighbour out of its bucket. */
+void LSUFCluster::NeighbourErasing( int slot ) {
+
+	// The buckets mirror the table, which moves its last entry into the hole.
+	mBuckets.erase( slot );
+
+}
+
+
+
 /** @brief Compute the CH weight for this node. */
 double LSUFCluster::calculateWeight() {
 
@@ -92,58 +150,22 @@ double LSUFCluster::calculateWeight() {
 		return 0;
 
 	// Fetch the weight of this lane, and it's flow ID
-	float laneWeight;
-	unsigned char flow;
-	if ( !LSUFCluster::mLaneWeightData->getLaneWeight( mRoadID+"_"+mLaneID, &laneWeight, &flow ) )
-		opp_error( "Tried to get weight for an unknown lane '%s' for current node #%d", (mRoadID+"_"+mLaneID).c_str(), mId );
+	LSUFData::LaneWeight w = LSUFCluster::mLaneWeightData->getLaneWeight( mLaneID );
+	float laneWeight = w.mWeight;
+	unsigned char flow = w.mFlowID;
+
+	// The bucket sums are relative to our own state, so rebuild them once we have moved past the tolerance.
+	Coord pos = mMobility->getCurrentPosition();
+	Coord vel = mMobility->getCurrentSpeed();
+	if ( !mBucketsValid || mBucketRoad != mRoadID
+	  || pos.distance( mBucketPosition ) > mBucketPositionTolerance
+	  || vel.distance( mBucketVelocity ) > mBucketVelocityTolerance )
+		RebuildBuckets( pos, vel );
 
 	/*
-	 * Now that we have the weight, we have to iterate through the neighbour table.
-	 * We calculate the Network Connectivity Level, the Average Distance Level,
-	 * and Average Velocity Level.
+	 * The Network Connectivity Level, the Average Distance Level,
+	 * and Average Velocity Level come straight from the buckets.
 	 */
-	int alpha = mNeighbours.size();
-	int beta = 0;
-	float delta = 0, chi = 0, sigma = 0, rho = 0;
-	for ( NeighbourIterator it = mNeighbours.begin(); it != mNeighbours.end(); it++ ) {
-
-		// This check does not appear to be part of the original algorithm.
-		if( it->second.mRoadID != mRoadID )
-			continue;	// We don't want to cluster with cars that are not on the same road as us.
-
-		// Calculate distance and difference in velocity
-		float dist, dv;
-		dist = mMobility->getCurrentPosition().distance( it->second.mPosition );
-		dv = mMobility->getCurrentSpeed().distance( it->second.mVelocity );
-
-		delta += dist;
-		sigma += dv;
-
-		// Get the flow ID of this neighbour.
-		unsigned char currFlow;
-		if ( !LSUFCluster::mLaneWeightData->getLaneWeight( it->second.mRoadID+"_"+it->second.mLaneID, NULL, &currFlow ) )
-			opp_error( "Tried to get weight for an unknown lane '%s' for current node #%d", (it->second.mRoadID+"_"+it->second.mLaneID).c_str(), it->first );
-
-		if ( currFlow == flow ) {
-			// This car is part of the same flow.
-			chi += dist;
-			rho += dv;
-			beta++;
-		}
-
-	}
-
-	delta /= alpha;
-	sigma /= alpha;
-	chi /= beta;
-	rho /= beta;
-
-	float NCL, ADL, AVL;
-
-	NCL =  beta + alpha * laneWeight;
-	ADL = delta +   chi * laneWeight;
-	AVL = sigma +   rho * laneWeight;
-
-	return NCL + ADL + AVL;
+	return mBuckets.utility( flow, mNeighbours.size(), laneWeight );
 
 }
@@ -23,11 +23,13 @@
 
 #include <set>
 #include <map>
+#include <vector>
 
 #include "MdmacControlMessage_m.h"
 #include "MdmacNetworkLayer.h"
 
 #include "LSUFData.h"
+#include "LSUFFlowBuckets.h"
 
 /**
  * Implements the Lane-Sense Utility Function (LSUF) Clustering metric.
@@ -45,6 +47,40 @@ protected:
 
     static LSUFData *mLaneWeightData;
 
+    /**
+     * @name Flow buckets
+     * @brief Per-flow sums over the neighbours on our road.
+     *
+     * The slots of the buckets mirror the neighbour table. A neighbour's flow
+     * is looked up when its packet arrives, and its terms are added to the
+     * bucket of that flow if it is on our road. Distances and velocity
+     * differences are relative to our own state at the last rebuild, and
+     * all buckets are rebuilt in one pass when we change road or have moved
+     * or changed velocity by more than a tolerance. Until then, each term is
+     * off by at most the tolerance, and so is each average.
+     */
+    /*@{*/
+    LSUFFlowBuckets mBuckets;						/**< Flow and terms of each neighbour, and their sums. */
+    bool mBucketsValid;								/**< Have the buckets been built yet? */
+    unsigned int mBucketRoad;						/**< Our road when the buckets were built. */
+    Coord mBucketPosition;							/**< Our position when the buckets were built. */
+    Coord mBucketVelocity;							/**< Our velocity when the buckets were built. */
+    double mBucketPositionTolerance;				/**< How far we may move before the buckets are rebuilt. */
+    double mBucketVelocityTolerance;				/**< How much our velocity may change before the buckets are rebuilt. */
+    /*@}*/
+
+    /** Recompute every neighbour's terms against our current state and rebuild the buckets. */
+    void RebuildBuckets( const Coord &pos, const Coord &vel );
+
+	/** Look up the flow of a neighbour whose data has changed and update its bucket. */
+	void NeighbourUpdated( int slot );
+
+	/** Compute the terms of the neighbour in the given slot against our state at the last rebuild. */
+	void SetBucket( int slot, unsigned char flow );
+
+	/** Take an expiring neighbour out of its bucket. */
+	void NeighbourErasing( int slot );
+
 	/** @brief Compute the CH weight for this node. */
 	double calculateWeight();
 };
@@ -6,14 +6,59 @@
  */
 
 #include <fstream>
+#include <cstring>
+#include <algorithm>
 #include "LSUFData.h"
+#include "SumoNameTable.h"
 
+#ifdef _WIN32
+#include <vector>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+#define LSUF_BINARY_MAGIC "LSUF"
+#define LSUF_BINARY_VERSION 1
+#define LSUF_BINARY_HEADER_SIZE 16
+#define LSUF_UNKNOWN_FLOW 255
 
 
 
 /** Default constructor */
 LSUFData::LSUFData( const char *filename ) {
 
+    mReferenceCount = 0;
+    mFileData = NULL;
+    mFileSize = 0;
+    mLaneCount = 0;
+    mNameOffsets = NULL;
+    mWeights = NULL;
+    mFlows = NULL;
+    mNames = NULL;
+
+    if ( !loadBinary( filename ) )
+        loadText( filename );
+
+}
+
+
+/** Default destructor */
+LSUFData::~LSUFData() {
+
+    mLaneWeights.clear();
+    unloadBinary();
+
+}
+
+
+
+/** Load a text file. */
+void LSUFData::loadText( const char *filename ) {
+
     std::ifstream ins;
     ins.open( filename );
 
@@ -27,12 +72,17 @@ LSUFData::LSUFData( const char *filename ) {
 
         std::string laneName;
         float weight;
-        unsigned char flow;
+        unsigned int flow;
 
         ins >> laneName >> weight >> flow;
 
-        mLaneWeights[laneName].mWeight = weight;
-        mLaneWeights[laneName].mFlowID = flow;
+        unsigned int laneId = SumoNameTable::internLane( laneName );
+        if ( laneId >= mLaneWeights.size() )
+            mLaneWeights.resize( laneId+1, LaneWeight() );
+        LaneWeight &w = mLaneWeights[laneId];
+        w.mWeight = weight;
+        w.mFlowID = flow;
+        w.mState = LANE_KNOWN;
 
     }
 
@@ -41,10 +91,146 @@ LSUFData::LSUFData( const char *filename ) {
 }
 
 
-/** Default destructor */
-LSUFData::~LSUFData() {
 
-    mLaneWeights.clear();
+/** Map a binary file. Returns false if the file is not in the binary format. */
+bool LSUFData::loadBinary( const char *filename ) {
+
+    // Check the magic number first, so text files fall through.
+    char magic[4];
+    std::ifstream ins( filename, std::ios::in | std::ios::binary );
+    if ( ins.fail() )
+    	throw "Could not load LSUF datafile";
+    if ( !ins.read( magic, 4 ) || memcmp( magic, LSUF_BINARY_MAGIC, 4 ) != 0 )
+        return false;
+
+#ifdef _WIN32
+    ins.seekg( 0, std::ios::end );
+    mFileSize = ins.tellg();
+    ins.seekg( 0, std::ios::beg );
+    char *data = new char[mFileSize];
+    ins.read( data, mFileSize );
+    mFileData = data;
+    ins.close();
+#else
+    ins.close();
+    int fd = open( filename, O_RDONLY );
+    struct stat st;
+    if ( fd < 0 || fstat( fd, &st ) != 0 ) {
+        if ( fd >= 0 )
+            close( fd );
+        throw "Could not load LSUF datafile";
+    }
+    mFileSize = st.st_size;
+    void *data = mmap( NULL, mFileSize, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if ( data == MAP_FAILED )
+        throw "Could not map LSUF datafile";
+    mFileData = static_cast<const char*>(data);
+#endif
+
+    // Nothing in the file is trusted until it has been checked, as a
+    // truncated or edited file would otherwise be read out of bounds.
+    if ( mFileSize < LSUF_BINARY_HEADER_SIZE ) {
+        unloadBinary();
+        throw "Truncated LSUF binary datafile";
+    }
+
+    const unsigned int *header = reinterpret_cast<const unsigned int*>(mFileData);
+    if ( header[1] != LSUF_BINARY_VERSION ) {
+        unloadBinary();
+        throw "Unsupported LSUF binary datafile version";
+    }
+
+    mLaneCount = header[2];
+    mNameOffsets = header + 4;
+    if ( !checkBinary() ) {
+        unloadBinary();
+        throw "Corrupt LSUF binary datafile";
+    }
+
+    mWeights = reinterpret_cast<const float*>( mNameOffsets + mLaneCount );
+    mFlows = reinterpret_cast<const unsigned char*>( mWeights + mLaneCount );
+    mNames = reinterpret_cast<const char*>( mFlows + mLaneCount );
+
+    return true;
+
+}
+
+
+
+/** Check that the header and every name offset of the mapped file lie within it. */
+bool LSUFData::checkBinary() const {
+
+    const unsigned int *header = reinterpret_cast<const unsigned int*>(mFileData);
+    size_t nameBytes = header[3];
+
+    // Compare by division so a huge lane count cannot overflow the sum.
+    size_t space = mFileSize - LSUF_BINARY_HEADER_SIZE;
+    size_t laneBytes = sizeof(unsigned int) + sizeof(float) + 1;
+    if ( mLaneCount > space / laneBytes || nameBytes > space - mLaneCount * laneBytes )
+        return false;
+
+    // Every name must start inside the name block, and the block must end
+    // with a NUL so that no name runs past it.
+    if ( mLaneCount == 0 )
+        return true;
+    const char *names = mFileData + LSUF_BINARY_HEADER_SIZE + mLaneCount * laneBytes;
+    if ( nameBytes == 0 || names[nameBytes-1] != '\0' )
+        return false;
+    for ( unsigned int i = 0; i < mLaneCount; i++ ) {
+        if ( mNameOffsets[i] >= nameBytes )
+            return false;
+    }
+
+    return true;
+
+}
+
+
+
+/** Release the mapped file. */
+void LSUFData::unloadBinary() {
+
+    if ( mFileData ) {
+#ifdef _WIN32
+        delete [] mFileData;
+#else
+        munmap( const_cast<char*>(mFileData), mFileSize );
+#endif
+    }
+
+    mFileData = NULL;
+    mFileSize = 0;
+    mLaneCount = 0;
+    mNameOffsets = NULL;
+    mWeights = NULL;
+    mFlows = NULL;
+    mNames = NULL;
+
+}
+
+
+
+/** Look up a lane in the binary file. Returns false if it is not there. */
+bool LSUFData::findBinary( const std::string &lane, LaneWeight *w ) {
+
+    // Binary search of the sorted name table.
+    unsigned int lo = 0, hi = mLaneCount;
+    while ( lo < hi ) {
+        unsigned int mid = lo + ( hi - lo ) / 2;
+        int c = strcmp( mNames + mNameOffsets[mid], lane.c_str() );
+        if ( c == 0 ) {
+            w->mWeight = mWeights[mid];
+            w->mFlowID = mFlows[mid];
+            return true;
+        }
+        if ( c < 0 )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return false;
 
 }
 
@@ -74,22 +260,38 @@ void LSUFData::release() {
 }
 
 
-/** Get the weight and flow ID of the given lane. */
-bool LSUFData::getLaneWeight( std::string strLane, float *weight, unsigned char *flow ) {
+/** Fill in the entry of a lane that has not been looked up yet. */
+const LSUFData::LaneWeight& LSUFData::resolve( unsigned int laneId ) {
 
-    if ( mLaneWeights.find( strLane ) == mLaneWeights.end() ) {
-        *flow = 0;
-	*weight = 1;
-        return true;
+    if ( laneId >= mLaneWeights.size() )
+        mLaneWeights.resize( std::max( laneId+1, SumoNameTable::size() ), LaneWeight() );
+
+    // Lanes missing from the file get a weight of 1 and a flow no real lane has.
+    // Text files are loaded up front, so only the binary file needs searching.
+    LaneWeight &w = mLaneWeights[laneId];
+    if ( mFileData && findBinary( SumoNameTable::name( laneId ), &w ) ) {
+        w.mState = LANE_KNOWN;
+    } else {
+        w.mWeight = 1;
+        w.mFlowID = LSUF_UNKNOWN_FLOW;
+        w.mState = LANE_UNKNOWN;
     }
 
-    if ( weight )
-    	*weight = mLaneWeights[strLane].mWeight;
+    return w;
+
+}
 
-    if ( flow )
-    	*flow = mLaneWeights[strLane].mFlowID;
 
-    return true;
+/** Get the weights and flow IDs of a batch of lanes. Either output array may be NULL. */
+void LSUFData::getLaneWeights( const unsigned int *laneIds, unsigned int count, float *weights, unsigned char *flows ) {
+
+    for ( unsigned int i = 0; i < count; i++ ) {
+        const LaneWeight &w = getLaneWeight( laneIds[i] );
+        if ( weights )
+            weights[i] = w.mWeight;
+        if ( flows )
+            flows[i] = w.mFlowID;
+    }
 
 }
 
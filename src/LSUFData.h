@@ -8,11 +8,44 @@
 #ifndef LSUFDATA_H_
 #define LSUFDATA_H_
 
-#include <map>
+#include <cstddef>
+#include <string>
+#include <vector>
 
+/**
+ * Lane weights and flow IDs used by LSUF.
+ *
+ * Two file formats are accepted. The text format written by
+ * tools/LaneWeight.py is parsed into memory. The binary format written by
+ * tools/LaneWeightBinary.py is memory-mapped, so simulation processes
+ * that load the same file share its pages. Lanes are only looked up in
+ * the mapped file the first time they are asked for.
+ *
+ * A binary file is checked when it is loaded, and rejected if its header
+ * or any name offset points outside it.
+ *
+ * Weights are kept in a dense array indexed by SumoNameTable ID, so a
+ * lookup of a lane that has been seen before is a single array access.
+ *
+ * Binary layout (little-endian):
+ *   char[4] magic "LSUF", uint32 version, uint32 lane count N, uint32 name bytes
+ *   uint32[N] offset of each lane name, sorted by name
+ *   float[N] lane weights
+ *   uint8[N] flow IDs
+ *   char[] NUL-terminated lane names
+ */
 class LSUFData {
 
-protected:
+public:
+
+    /**
+     * @brief State of an entry in the lane weight array.
+     */
+    enum LaneState {
+        LANE_UNRESOLVED = 0,    /**< Not looked up yet. */
+        LANE_KNOWN,             /**< The lane is in the file. */
+        LANE_UNKNOWN            /**< The lane is not in the file, and has the default weight. */
+    };
 
     /**
      * @brief Contains the weight of the lane.
@@ -20,13 +53,50 @@ protected:
     typedef struct LaneWeight {
         float mWeight;          /**< The weight of this lane. */
         unsigned char mFlowID;  /**< The ID of the flow to which this lane belongs. */
+        unsigned char mState;   /**< One of LaneState. */
     } LaneWeight;
 
-    typedef std::map<std::string,LaneWeight> LaneWeightData;
+protected:
+
+    typedef std::vector<LaneWeight> LaneWeightData;
 
-    LaneWeightData mLaneWeights;    /**< The lane weights. */
+    LaneWeightData mLaneWeights;    /**< The lane weights, indexed by SumoNameTable ID. */
     unsigned int mReferenceCount;   /**< The number of modules currently referencing this data container. */
 
+    /**
+     * @name Binary file
+     * @brief The mapped binary file. All NULL if the text format was loaded.
+     */
+    /*@{*/
+
+    const char *mFileData;                  /**< Start of the file. */
+    size_t mFileSize;                       /**< Size of the file in bytes. */
+    unsigned int mLaneCount;                /**< Number of lanes in the file. */
+    const unsigned int *mNameOffsets;       /**< Offset of each lane name, sorted by name. */
+    const float *mWeights;                  /**< Weight of each lane. */
+    const unsigned char *mFlows;            /**< Flow ID of each lane. */
+    const char *mNames;                     /**< Lane names. */
+
+    /*@}*/
+
+    /** Load a text file. */
+    void loadText( const char *filename );
+
+    /** Map a binary file. Returns false if the file is not in the binary format. */
+    bool loadBinary( const char *filename );
+
+    /** Check that the header and every name offset of the mapped file lie within it. */
+    bool checkBinary() const;
+
+    /** Release the mapped file. */
+    void unloadBinary();
+
+    /** Look up a lane in the binary file. Returns false if it is not there. */
+    bool findBinary( const std::string &lane, LaneWeight *w );
+
+    /** Fill in the entry of a lane that has not been looked up yet. */
+    const LaneWeight& resolve( unsigned int laneId );
+
 public:
     /** Default constructor */
     LSUFData( const char *filename );
@@ -43,8 +113,15 @@ public:
     /** Decrement the reference counter. */
     void release();
 
-    /** Get the weight and flow ID of the given lane. */
-    bool getLaneWeight( std::string strLane, float *weight, unsigned char *flow );
+    /** Get the weight and flow ID of the given lane, by its SumoNameTable ID. Lanes not in the file have mState LANE_UNKNOWN. The reference is only valid until the next lookup. */
+    const LaneWeight& getLaneWeight( unsigned int laneId ) {
+        if ( laneId < mLaneWeights.size() && mLaneWeights[laneId].mState != LANE_UNRESOLVED )
+            return mLaneWeights[laneId];
+        return resolve( laneId );
+    }
+
+    /** Get the weights and flow IDs of a batch of lanes. Either output array may be NULL. */
+    void getLaneWeights( const unsigned int *laneIds, unsigned int count, float *weights, unsigned char *flows );
 
 };
 
@@ -0,0 +1,120 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "LSUFFlowBuckets.h"
+
+#include <cstring>
+
+
+
+/** Set the neighbour in the given slot, replacing its terms in the buckets. A slot equal to size() is added. */
+void LSUFFlowBuckets::set( unsigned int slot, unsigned char flow, bool counted, float distance, float speed ) {
+
+	if ( slot == mFlow.size() ) {
+		mFlow.push_back( 0 );
+		mDistance.push_back( 0 );
+		mSpeed.push_back( 0 );
+		mCounted.push_back( false );
+	} else if ( mCounted[slot] ) {
+		count( slot, -1 );
+	}
+
+	mFlow[slot] = flow;
+	mDistance[slot] = distance;
+	mSpeed[slot] = speed;
+	mCounted[slot] = counted;
+	if ( counted )
+		count( slot, 1 );
+
+}
+
+
+
+/** Remove the neighbour in the given slot, moving the last slot into its place. */
+void LSUFFlowBuckets::erase( unsigned int slot ) {
+
+	if ( mCounted[slot] )
+		count( slot, -1 );
+
+	unsigned int last = mFlow.size() - 1;
+	mFlow[slot] = mFlow[last];
+	mDistance[slot] = mDistance[last];
+	mSpeed[slot] = mSpeed[last];
+	mCounted[slot] = mCounted[last];
+	mFlow.pop_back();
+	mDistance.pop_back();
+	mSpeed.pop_back();
+	mCounted.pop_back();
+
+	// If the sums have just emptied, drop any rounding error left in them.
+	if ( mRoadBucket.mCount == 0 )
+		clearSums();
+
+}
+
+
+
+/** Empty the buckets, leaving every slot in place but uncounted. */
+void LSUFFlowBuckets::clearSums() {
+
+	memset( mFlowBuckets, 0, sizeof( mFlowBuckets ) );
+	memset( &mRoadBucket, 0, sizeof( mRoadBucket ) );
+	mCounted.assign( mCounted.size(), false );
+
+}
+
+
+
+/**
+ * Compute the LSUF utility of a node on the given flow with the given number of neighbours.
+ *
+ * The averages are taken over all neighbours (alpha) and over the counted
+ * neighbours of the flow (beta). As in the original algorithm, an empty
+ * neighbourhood or flow makes its averages 0/0, and so the utility NaN.
+ */
+double LSUFFlowBuckets::utility( unsigned char flow, unsigned int neighbourCount, float laneWeight ) const {
+
+	int alpha = neighbourCount;
+	int beta = mFlowBuckets[flow].mCount;
+	float delta = mRoadBucket.mDistance / alpha;
+	float sigma = mRoadBucket.mSpeed / alpha;
+	float chi = mFlowBuckets[flow].mDistance / beta;
+	float rho = mFlowBuckets[flow].mSpeed / beta;
+
+	float NCL, ADL, AVL;
+
+	NCL =  beta + alpha * laneWeight;
+	ADL = delta +   chi * laneWeight;
+	AVL = sigma +   rho * laneWeight;
+
+	return NCL + ADL + AVL;
+
+}
+
+
+
+/** Add or remove the terms of the given slot. */
+void LSUFFlowBuckets::count( unsigned int slot, int sign ) {
+
+	Bucket &b = mFlowBuckets[mFlow[slot]];
+	b.mCount += sign;
+	b.mDistance += sign * mDistance[slot];
+	b.mSpeed += sign * mSpeed[slot];
+
+	mRoadBucket.mCount += sign;
+	mRoadBucket.mDistance += sign * mDistance[slot];
+	mRoadBucket.mSpeed += sign * mSpeed[slot];
+
+}
@@ -0,0 +1,88 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __CLUSTERLIB_LSUFFLOWBUCKETS_H_
+#define __CLUSTERLIB_LSUFFLOWBUCKETS_H_
+
+#include <vector>
+
+
+/**
+ * Per-flow running sums over the neighbours of an LSUF node.
+ *
+ * Each slot mirrors a slot of the neighbour table and holds the
+ * neighbour's flow ID and its distance and velocity difference from us.
+ * A slot may be counted or not; counted slots (the neighbours on our
+ * road) are summed into the bucket of their flow and into a road-wide
+ * bucket, so the LSUF utility is read from the buckets in O(1).
+ *
+ * Erasing a slot moves the last slot into the hole, as the neighbour
+ * table does.
+ */
+class LSUFFlowBuckets {
+
+public:
+
+	/**
+	 * @brief Running sums over a set of neighbours.
+	 */
+	struct Bucket {
+		unsigned int mCount;		/**< Number of neighbours. */
+		double mDistance;			/**< Sum of their distances from us. */
+		double mSpeed;				/**< Sum of their velocity differences from us. */
+	};
+
+	LSUFFlowBuckets() { clearSums(); }
+
+	/** Get the number of slots. */
+	unsigned int size() const { return mFlow.size(); }
+
+	/** Get the flow ID of the neighbour in the given slot. */
+	unsigned char flowOf( unsigned int slot ) const { return mFlow[slot]; }
+
+	/** Set the neighbour in the given slot, replacing its terms in the buckets. A slot equal to size() is added. */
+	void set( unsigned int slot, unsigned char flow, bool counted, float distance, float speed );
+
+	/** Remove the neighbour in the given slot, moving the last slot into its place. */
+	void erase( unsigned int slot );
+
+	/** Empty the buckets, leaving every slot in place but uncounted. */
+	void clearSums();
+
+	/** Get the sums for the counted neighbours of the given flow. */
+	const Bucket& flow( unsigned char flow ) const { return mFlowBuckets[flow]; }
+
+	/** Get the sums for all counted neighbours. */
+	const Bucket& road() const { return mRoadBucket; }
+
+	/** Compute the LSUF utility of a node on the given flow with the given number of neighbours. */
+	double utility( unsigned char flow, unsigned int neighbourCount, float laneWeight ) const;
+
+protected:
+
+	std::vector<unsigned char> mFlow;		/**< Flow ID of each neighbour. */
+	std::vector<float> mDistance;			/**< Distance of each neighbour from us. */
+	std::vector<float> mSpeed;				/**< Velocity difference of each neighbour from us. */
+	std::vector<char> mCounted;				/**< Is each neighbour counted in the buckets? */
+	Bucket mFlowBuckets[256];				/**< Sums for the neighbours of each flow. */
+	Bucket mRoadBucket;						/**< Sums for all counted neighbours. */
+
+	/** Add or remove the terms of the given slot. */
+	void count( unsigned int slot, int sign );
+
+};
+
+
+#endif
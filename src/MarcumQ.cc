@@ -17,39 +17,95 @@
 
 // Need this for Marcum Q function
 #include <boost/math/special_functions/bessel.hpp>
+#include <boost/math/special_functions/gamma.hpp>
 #include "MarcumQ.h"
 
+#include <vector>
+#include <algorithm>
 
 
-// Helper function to compute factorials.
-inline int factorial(int x) {
-	return (x <= 1 ? 1 : x * factorial(x - 1));
+
+// Upper bound on the terms of the basic iteration, in case it stops converging.
+#define MARCUMQ_MAX_TERMS 10000
+
+// Largest a*b for the basic iteration. Beyond it the Bessel functions overflow.
+#define MARCUMQ_BESSEL_LIMIT 700.0
+
+
+
+/**
+ * Compute Q_M(a,b) from its Poisson mixture form,
+ *     Q_M(a,b) = sum_k e^(-a^2/2) (a^2/2)^k / k! * Q(k+M,b^2/2),
+ * for a > 0. The sum starts a dozen standard deviations below a^2/2, where
+ * the weights are negligible, and runs until the terms are past both a^2/2
+ * and b^2/2 and no longer change it. Each weight and each increment of the
+ * incomplete gamma function follows from the last; the increments are kept
+ * as logarithms, since for large b the first ones underflow.
+ */
+static double MarcumQMixture( double a, double b, int M, int *terms ) {
+
+	double alpha = a*a/2, beta = b*b/2;
+	int first = (int)std::max( 0.0, floor( alpha - 12 * sqrt( alpha ) - 30 ) );
+	double peak = std::max( alpha, beta );
+
+	// w is the Poisson weight of k, u = Q(k+M,beta) and logG = log( e^-beta beta^n / n! ) with n = k+M.
+	double w = exp( first * log( alpha ) - alpha - boost::math::lgamma( first + 1.0 ) );
+	double u = boost::math::gamma_q( first + M, beta );
+	double logG = ( first + M ) * log( beta ) - beta - boost::math::lgamma( first + M + 1.0 );
+
+	double S = 0, t;
+	int k = first;
+	do {
+		t = w * u;
+		S += t;
+		w *= alpha / ( k+1 );
+		u += exp( logG );
+		logG += log( beta / ( k+M+1 ) );
+		k++;
+	} while ( ( k <= peak || t > S * std::numeric_limits<double>::epsilon() ) && k - first < MARCUMQ_MAX_TERMS );
+
+	*terms = k - first;
+	return S;
+
 }
 
 
 /**
- * This computes the Marcum Q function
+ * This computes the Marcum Q function.
+ * If terms is not NULL, it is set to the number of series terms summed.
  */
-double MarcumQ( double a, double b, int M ) {
+double MarcumQ( double a, double b, int M, int *terms ) {
 
+	int count = 0;
+	if ( terms == NULL )
+		terms = &count;
 
 	// Special cases.
+	*terms = 0;
 	if ( b == 0 )
 		return 1;
 
+	// Each term is the last times (b^2/2)/k, which avoids overflowing k! or (b^2/2)^k.
 	if ( a == 0 ) {
-		double Q=0;
-		for ( int k = 0; k <= M-1; k++ )
-			Q += pow(b,2*k)/(pow(2.0,k) * factorial(k));
-		return Q * exp(-pow(b,2)/2);
+		double Q = 0, term = 1, halfBSq = b*b/2;
+		for ( int k = 0; k <= M-1; k++ ) {
+			Q += term;
+			term *= halfBSq / ( k+1 );
+		}
+		*terms = M;
+		return Q * exp( -halfBSq );
 	}
 
+	if ( a*b > MARCUMQ_BESSEL_LIMIT )
+		return MarcumQMixture( a, b, M, terms );
+
 	// The basic iteration.  If a<b compute Q_M, otherwise compute 1-Q_M.
 	double qSign;
 	double constant;
 	int k = M;
 	double z = a*b;
 	double t = 1, d, S = 0, x;
+	double scale = exp( -fabs(z) );	// Keeps the Bessel terms in range.
 	if ( a < b ) {
 
 		qSign = +1;
@@ -57,15 +113,16 @@ double MarcumQ( double a, double b, int M ) {
 		x = a / b;
 		d = x;
 		k = 0;
-		S = exp( -fabs(z) ) * boost::math::cyl_bessel_i( 0, z );
+		S = scale * boost::math::cyl_bessel_i( 0, z );
 
 		for ( k = 1; k <= M-1; k++ ) {
-			t = ( d + 1/d ) * exp( -fabs(z) ) * boost::math::cyl_bessel_i( k, z );
+			t = ( d + 1/d ) * scale * boost::math::cyl_bessel_i( k, z );
 			S += t;
 			d *= x;
 		}
 
 		k = M;
+		*terms = M;
 
 	} else {
 
@@ -76,15 +133,59 @@ double MarcumQ( double a, double b, int M ) {
 
 	}
 
+	// Stop once a term no longer changes the sum. A zero sum has nothing left to add to.
+	int iterations = 0;
 	do {
-		t = d * exp( -fabs(z) ) * boost::math::cyl_bessel_i( fabs(k), z );
+		t = d * scale * boost::math::cyl_bessel_i( k, z );
 		S += t;
 		d *= x;
 		k++;
-	} while ( fabs(t/S) > std::numeric_limits<double>::epsilon() );
+		iterations++;
+	} while ( S != 0 && fabs(t/S) > std::numeric_limits<double>::epsilon() && iterations < MARCUMQ_MAX_TERMS );
+	*terms += iterations;
 
 	return constant + qSign * exp( -pow( a-b, 2 ) / 2 ) * S;
 
 }
 
 
+
+/**
+ * This computes the first order Marcum Q function for n pairs of arguments at once.
+ */
+void MarcumQ1( const double *a, const double *b, double *q, unsigned int n, unsigned int *iterations ) {
+
+	std::vector<double> alpha( n ), beta( n ), w( n ), g( n ), u( n );
+
+	// The Poisson weights of a^2/2 are negligible beyond ten standard deviations past the largest mean.
+	double alphaMax = 0;
+	for ( unsigned int i = 0; i < n; i++ ) {
+		alpha[i] = a[i] * a[i] / 2;
+		beta[i] = b[i] * b[i] / 2;
+		if ( alpha[i] > MARCUMQ_BATCH_LIMIT || beta[i] > MARCUMQ_BATCH_LIMIT )
+			alpha[i] = beta[i] = 0;		// Done separately below.
+		alphaMax = std::max( alphaMax, alpha[i] );
+		w[i] = exp( -alpha[i] );
+		g[i] = exp( -beta[i] );
+		u[i] = g[i];
+		q[i] = 0;
+	}
+	unsigned int terms = (unsigned int)ceil( alphaMax + 10 * sqrt( alphaMax ) + 25 );
+	if ( iterations )
+		*iterations = terms;
+
+	for ( unsigned int k = 0; k < terms; k++ ) {
+		double r = 1.0 / ( k + 1 );
+		for ( unsigned int i = 0; i < n; i++ ) {
+			q[i] += w[i] * u[i];
+			w[i] *= alpha[i] * r;
+			g[i] *= beta[i] * r;
+			u[i] += g[i];
+		}
+	}
+
+	for ( unsigned int i = 0; i < n; i++ )
+		if ( a[i] * a[i] / 2 > MARCUMQ_BATCH_LIMIT || b[i] * b[i] / 2 > MARCUMQ_BATCH_LIMIT )
+			q[i] = MarcumQ( a[i], b[i] );
+
+}
@@ -18,10 +18,46 @@
 
 
 
+#include <cstddef>
+
+
+
+/**
+ * This computes the Marcum Q function.
+ * If terms is not NULL, it is set to the number of series terms summed.
+ */
+double MarcumQ( double a, double b, int M = 1, int *terms = NULL );
+
+
+
+/**
+ * Largest a^2/2 or b^2/2 that MarcumQ1() evaluates itself. Beyond this,
+ * the leading terms of its series underflow and it calls MarcumQ().
+ */
+#define MARCUMQ_BATCH_LIMIT 600.0
+
+
+
 /**
- * This computes the Marcum Q function
+ * This computes the first order Marcum Q function, Q_1(a[i],b[i]), for n
+ * pairs of arguments at once.
+ *
+ * It sums the Poisson mixture form of Q_1,
+ *     Q_1(a,b) = sum_k e^(-a^2/2) (a^2/2)^k / k! * Q(k+1,b^2/2),
+ * where Q(k+1,x) = e^(-x) sum_{j<=k} x^j / j! is the regularised upper
+ * incomplete gamma function. Every term comes from a recurrence on the
+ * last, so there are no Bessel functions, factorials or powers, and every
+ * term is positive, so nothing cancels. All pairs take the same number of
+ * iterations, enough for the largest a in the batch, and the inner loop
+ * over the pairs has no branches, so the compiler can vectorise it.
+ *
+ * For a in [0,30] and b in [0,40] with ab < 700, where MarcumQ() sums
+ * Bessel functions, the result differs from MarcumQ() by less than 1e-13.
+ *
+ * If iterations is not NULL, it is set to the number of terms summed for
+ * every pair, not counting pairs passed on to MarcumQ().
  */
-double MarcumQ( double a, double b, int M = 1 );
+void MarcumQ1( const double *a, const double *b, double *q, unsigned int n, unsigned int *iterations = NULL );
 
 
 
@@ -0,0 +1,255 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "MarcumQTable.h"
+#include "MarcumQ.h"
+
+
+#define MARCUMQ_TABLE_MAGIC "MQ1T"
+#define MARCUMQ_TABLE_VERSION 1
+#define MARCUMQ_TABLE_HEADER_SIZE 56
+#define MARCUMQ_TABLE_MAX_SAMPLES 67108864.0
+
+
+MarcumQTable::TableMap MarcumQTable::msTables;
+
+
+
+/** Get the table for the given grid, building or loading it if needed. Call release() when done with it. */
+MarcumQTable* MarcumQTable::get( double range, double spacing, double maxError, const std::string &cacheDir ) {
+
+	if ( !( range > 0 && spacing > 0 && maxError > 0 ) )
+		throw "Marcum Q table range, spacing and error bound must be positive!";
+
+	char name[128];
+	sprintf( name, "marcumq-%g-%g-%g.bin", range, spacing, maxError );
+
+	MarcumQTable *table;
+	TableMap::iterator it = msTables.find( name );
+	if ( it == msTables.end() ) {
+		table = new MarcumQTable( name, range, spacing, maxError, cacheDir.empty() ? "" : cacheDir + "/" + name );
+		msTables[name] = table;
+	} else {
+		table = it->second;
+	}
+
+	table->mReferenceCount++;
+	return table;
+
+}
+
+
+
+/** Release a table obtained from get(). */
+void MarcumQTable::release() {
+
+	if ( --mReferenceCount > 0 )
+		return;
+
+	msTables.erase( mKey );
+	delete this;
+
+}
+
+
+
+/** Build or load the table. */
+MarcumQTable::MarcumQTable( const std::string &key, double range, double spacing, double maxError, const std::string &cacheFile ) :
+	mKey( key ),
+	mRange( range ),
+	mFileData( NULL ),
+	mFileSize( 0 ),
+	mReferenceCount( 0 ) {
+
+	if ( !cacheFile.empty() && load( cacheFile, range, spacing, maxError ) )
+		return;
+
+	// Refine the grid until interpolation is accurate enough.
+	for ( build( spacing ); mError > maxError; build( mSpacing / 2 ) ) {
+		if ( 4.0 * mRows * mColumns > MARCUMQ_TABLE_MAX_SAMPLES )
+			throw "Marcum Q table cannot meet its error bound!";
+	}
+
+	if ( !cacheFile.empty() )
+		save( cacheFile, range, spacing, maxError );
+
+}
+
+
+
+/** Unmap the cache file, if any. */
+MarcumQTable::~MarcumQTable() {
+
+	if ( mFileData ) {
+#ifdef _WIN32
+		delete [] mFileData;
+#else
+		munmap( const_cast<char*>(mFileData), mFileSize );
+#endif
+	}
+
+}
+
+
+
+/** Sample Q_1 at the given spacing and measure the interpolation error. */
+void MarcumQTable::build( double spacing ) {
+
+	mSpacing = spacing;
+	mInverseSpacing = 1 / spacing;
+	mRows = (unsigned int)ceil( mRange / spacing ) + 1;
+	mColumns = (unsigned int)ceil( ( mRange + 10 ) / spacing ) + 1;
+	mBuilt.resize( mRows * mColumns );
+	mSamples = &mBuilt[0];
+
+	// Sample a row at a time, so each batch only iterates as far as its own a needs.
+	std::vector<double> a( mColumns ), b( mColumns ), q( mColumns );
+	for ( unsigned int j = 0; j < mColumns; j++ )
+		b[j] = j * spacing;
+	for ( unsigned int i = 0; i < mRows; i++ ) {
+		std::fill( a.begin(), a.end(), i * spacing );
+		MarcumQ1( &a[0], &b[0], &q[0], mColumns );
+		for ( unsigned int j = 0; j < mColumns; j++ )
+			mBuilt[i * mColumns + j] = q[j];
+	}
+
+	// The interpolation error peaks around the middle of a cell, where the table is least informed.
+	mError = 0;
+	for ( unsigned int j = 0; j + 1 < mColumns; j++ )
+		b[j] = ( j + 0.5 ) * spacing;
+	for ( unsigned int i = 0; i + 1 < mRows; i++ ) {
+		std::fill( a.begin(), a.end(), ( i + 0.5 ) * spacing );
+		MarcumQ1( &a[0], &b[0], &q[0], mColumns - 1 );
+		for ( unsigned int j = 0; j + 1 < mColumns; j++ )
+			mError = std::max( mError, fabs( q[j] - lookup( a[j], b[j] ) ) );
+	}
+
+}
+
+
+
+/** Map a cache file. Returns false if there is none, or it was made for a different grid. */
+bool MarcumQTable::load( const std::string &cacheFile, double range, double spacing, double maxError ) {
+
+	char magic[4];
+	unsigned int header[3];
+	double grid[5];
+	std::ifstream ins( cacheFile.c_str(), std::ios::in | std::ios::binary );
+	if ( ins.fail() )
+		return false;
+	if ( !ins.read( magic, 4 ) || memcmp( magic, MARCUMQ_TABLE_MAGIC, 4 ) != 0 )
+		return false;
+	if ( !ins.read( (char*)header, sizeof(header) ) || !ins.read( (char*)grid, sizeof(grid) ) )
+		return false;
+	if ( header[0] != MARCUMQ_TABLE_VERSION || grid[0] != range || grid[1] != spacing || grid[2] != maxError )
+		return false;
+	ins.seekg( 0, std::ios::end );
+	size_t size = ins.tellg();
+	if ( size != MARCUMQ_TABLE_HEADER_SIZE + (size_t)header[1] * header[2] * sizeof(float) )
+		return false;
+
+#ifdef _WIN32
+	ins.seekg( 0, std::ios::beg );
+	char *data = new char[size];
+	ins.read( data, size );
+	ins.close();
+#else
+	ins.close();
+	int fd = open( cacheFile.c_str(), O_RDONLY );
+	if ( fd < 0 )
+		return false;
+	void *data = mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	if ( data == MAP_FAILED )
+		return false;
+#endif
+
+	mFileData = static_cast<const char*>(data);
+	mFileSize = size;
+	mRows = header[1];
+	mColumns = header[2];
+	mSpacing = grid[3];
+	mInverseSpacing = 1 / mSpacing;
+	mError = grid[4];
+	mSamples = reinterpret_cast<const float*>( mFileData + MARCUMQ_TABLE_HEADER_SIZE );
+	return true;
+
+}
+
+
+
+/** Write the table to a cache file. */
+void MarcumQTable::save( const std::string &cacheFile, double range, double spacing, double maxError ) const {
+
+	// Write to a temporary file of our own first, so other runs, which may be
+	// saving the same table at the same time, never map a partial table.
+#ifdef _WIN32
+	char suffix[32];
+	sprintf( suffix, ".%d.tmp", _getpid() );
+	std::string temporary = cacheFile + suffix;
+#else
+	std::string pattern = cacheFile + ".XXXXXX";
+	std::vector<char> name( pattern.begin(), pattern.end() );
+	name.push_back( '\0' );
+	int fd = mkstemp( &name[0] );
+	if ( fd < 0 )
+		return;		// The cache is only an optimisation.
+	fchmod( fd, 0644 );
+	close( fd );
+	std::string temporary( &name[0] );
+#endif
+	std::ofstream outs( temporary.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+	if ( outs.fail() ) {
+		remove( temporary.c_str() );
+		return;
+	}
+
+	unsigned int header[3] = { MARCUMQ_TABLE_VERSION, mRows, mColumns };
+	double grid[5] = { range, spacing, maxError, mSpacing, mError };
+	outs.write( MARCUMQ_TABLE_MAGIC, 4 );
+	outs.write( (const char*)header, sizeof(header) );
+	outs.write( (const char*)grid, sizeof(grid) );
+	outs.write( (const char*)mSamples, (size_t)mRows * mColumns * sizeof(float) );
+	outs.close();
+
+	if ( outs.fail() || rename( temporary.c_str(), cacheFile.c_str() ) != 0 )
+		remove( temporary.c_str() );
+
+}
+
+
+
+/** Compute Q_1(a,b) outside the grid. */
+double MarcumQTable::exact( double a, double b ) {
+
+	double q;
+	MarcumQ1( &a, &b, &q, 1 );
+	return q;
+
+}
@@ -0,0 +1,122 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __CLUSTERLIB_MARCUMQTABLE_H_
+#define __CLUSTERLIB_MARCUMQTABLE_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstddef>
+
+
+/**
+ * Interpolation table of the first order Marcum Q function, Q_1(a,b),
+ * used by CRAC to look up loss probabilities.
+ *
+ * Q_1 is sampled with MarcumQ1() on a square grid over a in [0,range] and
+ * b in [0,range+10]. A lookup reads the four samples around (a,b), two
+ * adjacent pairs from neighbouring rows, and interpolates bilinearly.
+ * Beyond the last column Q_1 is below 1e-20 and is taken as 0; beyond the
+ * last row MarcumQ1() is called. The grid starts at the requested spacing,
+ * which is halved until the error of interpolating at the cell centres is
+ * within the requested bound.
+ *
+ * Q_1 does not depend on the transmitter, so a table depends only on its
+ * range, spacing and error bound. If a cache directory is given, the
+ * table is saved to a file named after those, and later runs
+ * memory-map the file instead of building the table again. Tables are
+ * shared by reference counting, like DestinationStore. Errors are thrown
+ * as C strings, like LSUFData, so the table does not need OMNeT++.
+ *
+ * Cache layout (native byte order):
+ *   char[4] magic "MQ1T", uint32 version, uint32 rows, uint32 columns
+ *   double range, requested spacing, error bound, spacing, measured error
+ *   float[rows*columns] samples, one row per value of a
+ */
+class MarcumQTable {
+
+public:
+
+	/** Get the table for the given grid, building or loading it if needed. Call release() when done with it. */
+	static MarcumQTable* get( double range, double spacing, double maxError, const std::string &cacheDir );
+
+	/** Release a table obtained from get(). */
+	void release();
+
+	/** Look up Q_1(a,b). */
+	double lookup( double a, double b ) const {
+		if ( !( a >= 0 && a <= mRange && b >= 0 ) )
+			return exact( a, b );
+		double y = b * mInverseSpacing;
+		if ( y >= mColumns - 1 )
+			return 0;
+		double x = a * mInverseSpacing;
+		unsigned int i = x < mRows - 2 ? (unsigned int)x : mRows - 2;
+		unsigned int j = (unsigned int)y;
+		double fx = x - i, fy = y - j;
+		const float *p = mSamples + i * mColumns + j;
+		double top = p[0] + fy * ( p[1] - p[0] );
+		double bottom = p[mColumns] + fy * ( p[mColumns+1] - p[mColumns] );
+		return top + fx * ( bottom - top );
+	}
+
+	/** Get the spacing of the grid, after any refinement. */
+	double spacing() const { return mSpacing; }
+
+	/** Get the largest interpolation error measured at the cell centres. */
+	double error() const { return mError; }
+
+protected:
+
+	typedef std::map<std::string,MarcumQTable*> TableMap;
+
+	std::string mKey;					/**< Key of this table in msTables. */
+	double mRange;						/**< Largest a in the grid. */
+	double mSpacing;					/**< Distance between samples. */
+	double mInverseSpacing;				/**< 1 / mSpacing. */
+	double mError;						/**< Largest interpolation error measured at the cell centres. */
+	unsigned int mRows;					/**< Number of samples of a. */
+	unsigned int mColumns;				/**< Number of samples of b. */
+	const float *mSamples;				/**< Q_1 at each grid point, in mBuilt or the mapped file. */
+	std::vector<float> mBuilt;			/**< Samples of a table built in this run. */
+	const char *mFileData;				/**< Start of the mapped cache file, or NULL. */
+	size_t mFileSize;					/**< Size of the mapped cache file in bytes. */
+	unsigned int mReferenceCount;		/**< The number of modules currently referencing this table. */
+
+	static TableMap msTables;			/**< Tables in use, by key. */
+
+	/** Build or load the table. */
+	MarcumQTable( const std::string &key, double range, double spacing, double maxError, const std::string &cacheFile );
+
+	/** Unmap the cache file, if any. */
+	~MarcumQTable();
+
+	/** Sample Q_1 at the given spacing and measure the interpolation error. */
+	void build( double spacing );
+
+	/** Map a cache file. Returns false if there is none, or it was made for a different grid. */
+	bool load( const std::string &cacheFile, double range, double spacing, double maxError );
+
+	/** Write the table to a cache file. */
+	void save( const std::string &cacheFile, double range, double spacing, double maxError ) const;
+
+	/** Compute Q_1(a,b) outside the grid. */
+	static double exact( double a, double b );
+
+};
+
+
+#endif
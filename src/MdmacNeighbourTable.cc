@@ -0,0 +1,184 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "MdmacNeighbourTable.h"
+
+
+
+/** Get the slot of the given node, or -1 if it is not in the table. */
+int MdmacNeighbourTable::find( unsigned int id ) const {
+
+	SlotIndex::const_iterator it = mSlotIndex.find( id );
+	if ( it == mSlotIndex.end() )
+		return -1;
+	return it->second;
+
+}
+
+
+
+/** Get the slot of the given node, adding an empty entry if it is not in the table. */
+int MdmacNeighbourTable::insert( unsigned int id ) {
+
+	std::pair<SlotIndex::iterator,bool> r = mSlotIndex.insert( SlotIndex::value_type( id, mId.size() ) );
+	if ( !r.second )
+		return r.first->second;
+
+	mId.push_back( id );
+	mWeight.push_back( 0 );
+	mPosition.push_back( Coord() );
+	mVelocity.push_back( Coord() );
+	mDestination.push_back( Coord() );
+	mTerm.push_back( 0 );
+	mExpiry.push_back( 0 );
+	mIsClusterHead.push_back( false );
+	mInfo.push_back( NeighbourInfo() );
+	mInfo.back().mRoadID = 0;
+	mInfo.back().mLaneID = 0;
+
+	return r.first->second;
+
+}
+
+
+
+/** Remove the given node from the table. Returns false if it was not there. */
+bool MdmacNeighbourTable::erase( unsigned int id ) {
+
+	SlotIndex::iterator it = mSlotIndex.find( id );
+	if ( it == mSlotIndex.end() )
+		return false;
+
+	// Fill the hole with the last entry so the arrays stay dense.
+	unsigned int slot = it->second;
+	unsigned int last = mId.size() - 1;
+	mSlotIndex.erase( it );
+	mTermTotal -= mTerm[slot];
+
+	if ( slot != last ) {
+		mId[slot] = mId[last];
+		mWeight[slot] = mWeight[last];
+		mPosition[slot] = mPosition[last];
+		mVelocity[slot] = mVelocity[last];
+		mDestination[slot] = mDestination[last];
+		mTerm[slot] = mTerm[last];
+		mExpiry[slot] = mExpiry[last];
+		mIsClusterHead[slot] = mIsClusterHead[last];
+		mInfo[slot].mRoadID = mInfo[last].mRoadID;
+		mInfo[slot].mLaneID = mInfo[last].mLaneID;
+		mInfo[slot].mRouteLinks.swap( mInfo[last].mRouteLinks );
+		mSlotIndex[mId[slot]] = slot;
+	}
+
+	mId.pop_back();
+	mWeight.pop_back();
+	mPosition.pop_back();
+	mVelocity.pop_back();
+	mDestination.pop_back();
+	mTerm.pop_back();
+	mExpiry.pop_back();
+	mIsClusterHead.pop_back();
+	mInfo.pop_back();
+
+	return true;
+
+}
+
+
+
+/** Remove all neighbours. */
+void MdmacNeighbourTable::clear() {
+
+	mSlotIndex.clear();
+	mId.clear();
+	mWeight.clear();
+	mPosition.clear();
+	mVelocity.clear();
+	mDestination.clear();
+	mTerm.clear();
+	mTermTotal = 0;
+	mExpiry.clear();
+	mExpiryQueue = ExpiryQueue();
+	mIsClusterHead.clear();
+	mInfo.clear();
+
+}
+
+
+
+/** Recompute the running total from the stored terms. */
+void MdmacNeighbourTable::sumTerms() {
+
+	mTermTotal = 0;
+	for ( unsigned int i = 0; i < mTerm.size(); i++ )
+		mTermTotal += mTerm[i];
+
+}
+
+
+
+/** Set the time at which the link to the neighbour in the given slot expires. */
+void MdmacNeighbourTable::setExpiry( int slot, simtime_t expiry ) {
+
+	// Any earlier heap entry for this neighbour becomes stale.
+	mExpiry[slot] = expiry;
+	mExpiryQueue.push( ExpiryEntry( expiry, mId[slot] ) );
+
+	// Rebuild the heap from the table if stale entries start to dominate it.
+	if ( mExpiryQueue.size() > 4 * mId.size() + 64 ) {
+		std::vector<ExpiryEntry> entries;
+		entries.reserve( mId.size() );
+		for ( unsigned int i = 0; i < mId.size(); i++ )
+			entries.push_back( ExpiryEntry( mExpiry[i], mId[i] ) );
+		mExpiryQueue = ExpiryQueue( std::greater<ExpiryEntry>(), entries );
+	}
+
+}
+
+
+
+/** Pop the ID of a neighbour whose link has expired by the given time. Returns false if there is none. */
+bool MdmacNeighbourTable::nextExpired( simtime_t now, unsigned int &id ) {
+
+	while ( !mExpiryQueue.empty() && mExpiryQueue.top().first <= now ) {
+
+		ExpiryEntry e = mExpiryQueue.top();
+		mExpiryQueue.pop();
+
+		// Only report the entry if it is still the neighbour's current expiry time.
+		int slot = find( e.second );
+		if ( slot != -1 && mExpiry[slot] == e.first ) {
+			id = e.second;
+			return true;
+		}
+
+	}
+
+	return false;
+
+}
+
+
+
+std::ostream& operator<<( std::ostream& os, const MdmacNeighbourTable& t ) {
+
+	os << t.size() << " neighbours";
+	for ( unsigned int i = 0; i < t.size(); i++ ) {
+		os << "; [" << t.mId[i] << "] Weight = " << t.mWeight[i] << "; Pos = " << t.mPosition[i] << "; Vel = " << t.mVelocity[i];
+		os << "; C" << ( t.mIsClusterHead[i] ? "H" : "M" ) << "; expiry = " << t.mExpiry[i];
+	}
+	return os;
+
+}
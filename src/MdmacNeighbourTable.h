@@ -0,0 +1,131 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __CLUSTERLIB_MDMACNEIGHBOURTABLE_H_
+#define __CLUSTERLIB_MDMACNEIGHBOURTABLE_H_
+
+#include <omnetpp.h>
+#include <Coord.h>
+
+#include "EdgeRoute.h"
+
+#include <ostream>
+#include <vector>
+#include <map>
+#include <queue>
+#include <functional>
+
+
+/**
+ * Neighbour table used by the M-DMAC family of cluster modules.
+ *
+ * Neighbours live in a dense array of slots, with a lookup from node ID
+ * to slot. The fields read on every beat (weight, position, velocity,
+ * link expiry, CH flag) each get their own contiguous array, so the
+ * weight metrics are linear passes over memory. Everything else sits in
+ * a separate array of NeighbourInfo records.
+ *
+ * Each link carries the absolute time at which it expires. Expiry times
+ * are also kept in a min-heap, so finding the links that have failed
+ * costs work proportional to the number of expiring links rather than
+ * the size of the table. Heap entries are discarded lazily: an entry is
+ * stale once the neighbour has been erased or given a new expiry time.
+ *
+ * Erasing a neighbour moves the entry in the last slot into the hole, so
+ * slot indices are only stable until the next erase.
+ */
+class MdmacNeighbourTable {
+
+public:
+
+	/**
+	 * @brief Fields of a neighbour that are not needed on every beat.
+	 */
+	struct NeighbourInfo {
+		unsigned int mRoadID;				/**< The interned ID of the road this car is on. */
+		unsigned int mLaneID;				/**< The interned ID of the lane this car is on. */
+		EdgeRoute mRouteLinks;				/**< The next N links in this neighbour's route. */
+	};
+
+	/**
+	 * @name Slot arrays
+	 * @brief Per-neighbour data, indexed by slot.
+	 */
+	/*@{*/
+
+	std::vector<unsigned int> mId;			/**< ID of the node in each slot. */
+	std::vector<double> mWeight;			/**< Weight of the node. */
+	std::vector<Coord> mPosition;			/**< Position of the node. */
+	std::vector<Coord> mVelocity;			/**< Velocity of the node. */
+	std::vector<Coord> mDestination;		/**< Destination of the node. */
+	std::vector<double> mTerm;				/**< Contribution of the node to our own weight. */
+	std::vector<simtime_t> mExpiry;			/**< Time at which this node will leave our range. */
+	std::vector<char> mIsClusterHead;		/**< Is this node a CH? */
+	std::vector<NeighbourInfo> mInfo;		/**< Remaining data of the node. */
+
+	/*@}*/
+
+	MdmacNeighbourTable() : mTermTotal(0) {}
+
+	/** Get the number of neighbours in the table. */
+	unsigned int size() const { return mId.size(); }
+
+	/** Check whether the table is empty. */
+	bool empty() const { return mId.empty(); }
+
+	/** Get the slot of the given node, or -1 if it is not in the table. */
+	int find( unsigned int id ) const;
+
+	/** Get the slot of the given node, adding an empty entry if it is not in the table. */
+	int insert( unsigned int id );
+
+	/** Remove the given node from the table. Returns false if it was not there. */
+	bool erase( unsigned int id );
+
+	/** Remove all neighbours. */
+	void clear();
+
+	/** Set the weight term of the neighbour in the given slot, updating the running total. */
+	void setTerm( int slot, double term ) { mTermTotal += term - mTerm[slot]; mTerm[slot] = term; }
+
+	/** Recompute the running total from the stored terms. */
+	void sumTerms();
+
+	/** Get the sum of the weight terms of all neighbours. */
+	double termTotal() const { return mTermTotal; }
+
+	/** Set the time at which the link to the neighbour in the given slot expires. */
+	void setExpiry( int slot, simtime_t expiry );
+
+	/** Pop the ID of a neighbour whose link has expired by the given time. Returns false if there is none. */
+	bool nextExpired( simtime_t now, unsigned int &id );
+
+protected:
+
+	typedef std::map<unsigned int,unsigned int> SlotIndex;
+	typedef std::pair<simtime_t,unsigned int> ExpiryEntry;
+	typedef std::priority_queue<ExpiryEntry,std::vector<ExpiryEntry>,std::greater<ExpiryEntry> > ExpiryQueue;
+
+	SlotIndex mSlotIndex;					/**< Lookup of node ID to slot. */
+	ExpiryQueue mExpiryQueue;				/**< Pending link expiry times, earliest first. */
+	double mTermTotal;						/**< Sum of mTerm. */
+
+};
+
+
+std::ostream& operator<<( std::ostream& os, const MdmacNeighbourTable& t );
+
+
+#endif
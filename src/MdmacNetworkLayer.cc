@@ -38,13 +38,6 @@
 
 Define_Module(MdmacNetworkLayer);
 
-std::ostream& operator<<( std::ostream& os, const MdmacNetworkLayer::Neighbour& n ) {
-
-	os << "Weight = " << n.mWeight << "; Pos = " << n.mPosition << "; Vel = " << n.mVelocity << "; C" << ( n.mIsClusterHead ? "H" : "M" ) << "; freshness = " << n.mFreshness;
-	return os;
-
-}
-
 void MdmacNetworkLayer::initialize(int stage)
 {
 	ClusterAlgorithm::initialize(stage);
@@ -83,7 +76,7 @@ void MdmacNetworkLayer::initialize(int stage)
 
     	// set up watches
     	WATCH_SET( mClusterMembers );
-    	WATCH_MAP( mNeighbours );
+    	WATCH( mNeighbours );
     	WATCH( mWeight );
     	WATCH( mClusterHead );
 
@@ -347,9 +340,8 @@ void MdmacNetworkLayer::init() {
 	// First get the lane we're in.
 	TraCIScenarioManager *pManager = TraCIScenarioManagerAccess().get();
 	std::string s = pManager->commandGetLaneId( dynamic_cast<TraCIMobility*>(mMobility)->getExternalId() );
-	int i = s.find("_");
-	mRoadID = s.substr( 0, i );
-	mLaneID = s.substr( i+1 );
+	mLaneID = SumoNameTable::internLane( s );
+	mRoadID = SumoNameTable::edgeOf( mLaneID );
 
 	int nMax = chooseClusterHead();
 	if ( nMax == -1 ) {
@@ -380,36 +372,21 @@ void MdmacNetworkLayer::init() {
 
 
 
-/** @brief Process the neighbour table in one beat. Also, update the node's weight. */
+/** @brief Fail the links that have expired by this beat. Also, update the node's weight. */
 void MdmacNetworkLayer::processBeat() {
 
 	// update the node's weight
 	mWeight = calculateWeight();
 
-	// process the neighbour table
-	NeighbourIterator it = mNeighbours.begin();
-	for ( ; it != mNeighbours.end(); ) {
-
-		it->second.mFreshness -= 1;
-		if ( it->second.mFreshness == 0 ) {
-
-			unsigned int nodeId = it->first;
-			it++;
-			linkFailure( nodeId );
-
-		} else {
-
-			++it;
-
-		}
-
-	}
+	// fail the links whose expiry time has passed
+	unsigned int nodeId;
+	while ( mNeighbours.nextExpired( simTime(), nodeId ) )
+		linkFailure( nodeId );
 
 	TraCIScenarioManager *pManager = TraCIScenarioManagerAccess().get();
 	std::string s = pManager->commandGetLaneId( dynamic_cast<TraCIMobility*>(mMobility)->getExternalId() );
-	int i = s.find("_");
-	mRoadID = s.substr( 0, i );
-	mLaneID = s.substr( i+1 );
+	mLaneID = SumoNameTable::internLane( s );
+	mRoadID = SumoNameTable::edgeOf( mLaneID );
 
 // 	TraCIScenarioManager *pManager = TraCIScenarioManagerAccess().get();
 // 	char strNodeName[10];
@@ -433,13 +410,12 @@ int MdmacNetworkLayer::chooseClusterHead() {
 	int nCurr = -1;
 	double wCurr = mWeight;
 
-	NeighbourIterator it = mNeighbours.begin();
-	for ( ; it != mNeighbours.end(); it++ ) {
+	for ( unsigned int i = 0; i < mNeighbours.size(); i++ ) {
 
-		if ( it->second.mIsClusterHead && it->second.mWeight > wCurr ) {
+		if ( mNeighbours.mIsClusterHead[i] && mNeighbours.mWeight[i] > wCurr ) {
 
-			nCurr = it->first;
-			wCurr = it->second.mWeight;
+			nCurr = mNeighbours.mId[i];
+			wCurr = mNeighbours.mWeight[i];
 
 		}
 
@@ -451,9 +427,12 @@ int MdmacNetworkLayer::chooseClusterHead() {
 
 
 
-/** @brief Handle a link failure. Link failure is detected when a CMs freshness reaches 0. */
+/** @brief Handle a link failure. Link failure is detected when a neighbour's link expiry time passes. */
 void MdmacNetworkLayer::linkFailure( unsigned int nodeId ) {
 
+	int slot = mNeighbours.find( nodeId );
+	if ( slot != -1 )
+		NeighbourErasing( slot );
 	mNeighbours.erase( nodeId );
 	if ( IsClusterHead() ) {
 
@@ -480,12 +459,12 @@ void MdmacNetworkLayer::linkFailure( unsigned int nodeId ) {
 
 
 
-/** @brief Calculate the freshness of the given neighbour. */
-void MdmacNetworkLayer::calculateFreshness( unsigned int nodeId ) {
+/** @brief Calculate the freshness of the neighbour in the given slot, and set its link expiry time. */
+void MdmacNetworkLayer::calculateFreshness( int slot ) {
 
 	unsigned int freshness = mInitialFreshness;
-	Coord v =    mMobility->getCurrentSpeed() - mNeighbours[ nodeId ].mVelocity;
-	Coord p = mMobility->getCurrentPosition() - mNeighbours[ nodeId ].mPosition;
+	Coord v =    mMobility->getCurrentSpeed() - mNeighbours.mVelocity[slot];
+	Coord p = mMobility->getCurrentPosition() - mNeighbours.mPosition[slot];
 
 	double a = v.squareLength(), b, c;
 	if ( a > 0 ) {
@@ -502,7 +481,19 @@ void MdmacNetworkLayer::calculateFreshness( unsigned int nodeId ) {
 
 	}
 
-	mNeighbours[nodeId].mFreshness = freshness;
+	mNeighbours.setExpiry( slot, simTime() + freshness * BEAT_LENGTH );
+
+}
+
+
+
+/** @brief Get the number of beats until the link to the neighbour in the given slot expires. */
+unsigned int MdmacNetworkLayer::getFreshness( int slot ) {
+
+	simtime_t remaining = mNeighbours.mExpiry[slot] - simTime();
+	if ( remaining <= 0 )
+		return 0;
+	return (unsigned int)floor( remaining.dbl() / BEAT_LENGTH );
 
 }
 
@@ -511,12 +502,26 @@ void MdmacNetworkLayer::calculateFreshness( unsigned int nodeId ) {
 /** @brief Determine whether the given node is a suitable CH. */
 bool MdmacNetworkLayer::testClusterHeadChange( unsigned int nodeId ) {
 
-	bool t1 = mNeighbours[nodeId].mIsClusterHead;
-	bool t2 = mNeighbours[nodeId].mWeight > ( mIsClusterHead ? mWeight : mNeighbours[mClusterHead].mWeight );
-	bool t3 = mNeighbours[nodeId].mFreshness >= mFreshnessThreshold;
+	int slot = mNeighbours.find( nodeId );
+	if ( slot == -1 )
+		return false;
+
+	// A CH we no longer have an entry for counts as weight zero.
+	double chWeight = 0;
+	if ( mIsClusterHead ) {
+		chWeight = mWeight;
+	} else {
+		int chSlot = mNeighbours.find( mClusterHead );
+		if ( chSlot != -1 )
+			chWeight = mNeighbours.mWeight[chSlot];
+	}
+
+	bool t1 = mNeighbours.mIsClusterHead[slot];
+	bool t2 = mNeighbours.mWeight[slot] > chWeight;
+	bool t3 = getFreshness( slot ) >= mFreshnessThreshold;
 
 	Coord v1 = mMobility->getCurrentSpeed();
-	Coord v2 = mNeighbours[ nodeId ].mVelocity;
+	Coord v2 = mNeighbours.mVelocity[slot];
 	double angle = cos( ( v1.x*v2.x + v1.y*v2.y ) / ( v1.length() * v2.length() ) );
 
 	bool t4 = angle <= mAngleThreshold;
@@ -649,21 +654,23 @@ void MdmacNetworkLayer::receiveJoinMessage( MdmacControlMessage *m ) {
 void MdmacNetworkLayer::updateNeighbour( MdmacControlMessage *m ) {
 
 	// update the neighbour data
-	mNeighbours[m->getNodeId()].mWeight = m->getWeight();
-	mNeighbours[m->getNodeId()].mIsClusterHead = m->getIsClusterHead();
-	mNeighbours[m->getNodeId()].mRoadID = m->getRoadId();
-	mNeighbours[m->getNodeId()].mLaneID = m->getLaneId();
-	mNeighbours[m->getNodeId()].mPosition.x = m->getXPosition();
-	mNeighbours[m->getNodeId()].mPosition.y = m->getYPosition();
-	mNeighbours[m->getNodeId()].mVelocity.x = m->getXVelocity();
-	mNeighbours[m->getNodeId()].mVelocity.y = m->getYVelocity();
+	int slot = mNeighbours.insert( m->getNodeId() );
+	mNeighbours.mWeight[slot] = m->getWeight();
+	mNeighbours.mIsClusterHead[slot] = m->getIsClusterHead();
+	mNeighbours.mInfo[slot].mRoadID = m->getRoadId();
+	mNeighbours.mInfo[slot].mLaneID = m->getLaneId();
+	mNeighbours.mPosition[slot].x = m->getXPosition();
+	mNeighbours.mPosition[slot].y = m->getYPosition();
+	mNeighbours.mVelocity[slot].x = m->getXVelocity();
+	mNeighbours.mVelocity[slot].y = m->getYVelocity();
 
 	if ( mIncludeDestination ) {
 		StoreDestinationData( m );
 		//std::cerr << "Dest(" << m->getNodeId() << ") = (" << m->getXDestination() << "," << m->getYDestination() << ")\n";
 	}
 
-	calculateFreshness( m->getNodeId() );
+	NeighbourUpdated( slot );
+	calculateFreshness( slot );
 
 }
 
@@ -698,8 +705,8 @@ void MdmacNetworkLayer::sendClusterMessage( int kind, int dest, int nHops ) {
     	nHops = mHopCount;
     pkt->setTtl( nHops );
 
-    pkt->setRoadId( mRoadID.c_str() );
-    pkt->setLaneId( mLaneID.c_str() );
+    pkt->setRoadId( mRoadID );
+    pkt->setLaneId( mLaneID );
 
     Coord p = mMobility->getCurrentPosition();
     pkt->setXPosition( p.x );
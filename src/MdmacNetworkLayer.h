@@ -26,6 +26,8 @@
 #include <map>
 
 #include "ClusterAlgorithm.h"
+#include "MdmacNeighbourTable.h"
+#include "SumoNameTable.h"
 
 #define BEAT_LENGTH	0.25	// measured in second.
 
@@ -53,36 +55,20 @@ public:
 	};
 
 
-    typedef std::list<std::string> RouteLinkList;
-
-	struct Neighbour {
-		double mWeight;						/**< Weight of this node. */
-		Coord mPosition;					/**< Position of the Neighbour. */
-		Coord mVelocity;					/**< Velocity of the Neighbour. */
-		std::string mRoadID;				/**< The ID of the road this car is on. */
-		std::string mLaneID;				/**< The ID of the lane this car is on. */
-		Coord mDestination;					/**< The node's destination. */
-		RouteLinkList mRouteLinks;			/**< The next N links in this neighbour's route. */
-		bool mIsClusterHead;				/**< Is this node a CH? */
-		unsigned int mFreshness;			/**< How long this node will stay in range of this neighbour. Measured in beats. */
-	};
 
 protected:
 
 
-	typedef std::map<unsigned int,Neighbour> NeighbourSet;
-	typedef std::map<unsigned int,Neighbour>::iterator NeighbourIterator;
-
 	//unsigned int mID;						/**< Node's unique ID. */
 	double mWeight;							/**< Weight of this node. */
 
-	std::string mRoadID;					/**< The ID of the road this car is on. */
-	std::string mLaneID;					/**< The ID of the lane this car is on. */
+	unsigned int mRoadID;					/**< The interned ID of the road this car is on. */
+	unsigned int mLaneID;					/**< The interned ID of the lane this car is on. */
 
 	bool mIncludeDestination;				/**< Include the destination in the HELLO messages. */
 
 	bool mIsClusterHead;					/**< Is this node a CH? */
-	NeighbourSet mNeighbours;				/**< The set of neighbours near this node. */
+	MdmacNeighbourTable mNeighbours;		/**< The set of neighbours near this node. */
 
 	double mTransmitRangeSq;				/**< Required for the freshness calculation. Obtained from the PhyLayer module. */
 
@@ -173,6 +159,12 @@ protected:
 	/** Store the destination data from a packet. */
 	virtual void StoreDestinationData( MdmacControlMessage *pkt );
 
+	/** Called once the neighbour in the given slot has been updated from a packet. */
+	virtual void NeighbourUpdated( int slot ) {}
+
+	/** Called before the neighbour in the given slot is erased, and the last slot moved into its place. */
+	virtual void NeighbourErasing( int slot ) {}
+
 	/**
      * @name Cluster Methods
      * @brief Methods handling the formation and maintenance of clusters.
@@ -186,17 +178,20 @@ protected:
     /** @brief Initiate clustering. */
     void init();
 
-    /** @brief Process the neighbour table in one beat. Also, update the node's weight. */
+    /** @brief Fail the links that have expired by this beat. Also, update the node's weight. */
     void processBeat();
 
     /** @brief Select a CH from the neighbour table. */
     int chooseClusterHead();
 
-    /** @brief Handle a link failure. Link failure is detected when a CMs freshness reaches 0. */
+    /** @brief Handle a link failure. Link failure is detected when a neighbour's link expiry time passes. */
     void linkFailure( unsigned int );
 
-    /** @brief Calculate the freshness of the given neighbour. */
-    void calculateFreshness( unsigned int );
+    /** @brief Calculate the freshness of the neighbour in the given slot, and set its link expiry time. */
+    void calculateFreshness( int );
+
+    /** @brief Get the number of beats until the link to the neighbour in the given slot expires. */
+    unsigned int getFreshness( int );
 
     /** @brief Determine whether the given node is a suitable CH. */
     bool testClusterHeadChange( unsigned int );
@@ -0,0 +1,125 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "NeighbourChangeLog.h"
+
+
+
+/** Record that the entry of the given node was removed. */
+void NeighbourChangeLog::remove( unsigned int id ) {
+
+	// Nothing to tell anyone if the node was never logged.
+	if ( mEntryVersion.find( id ) == mEntryVersion.end() )
+		return;
+
+	record( id, true );
+	pruneRemovals();
+
+}
+
+
+
+/** Get the version of our table the peer has acknowledged. */
+unsigned int NeighbourChangeLog::acknowledged( unsigned int peer ) const {
+
+	VersionMap::const_iterator it = mAcknowledged.find( peer );
+	return it == mAcknowledged.end() ? 0 : it->second;
+
+}
+
+
+
+/** Record the version of our table the peer has acknowledged. */
+void NeighbourChangeLog::setAcknowledged( unsigned int peer, unsigned int version ) {
+
+	// Never trust an acknowledgement of something we haven't sent yet.
+	mAcknowledged[peer] = version > mVersion ? 0 : version;
+	pruneRemovals();
+
+}
+
+
+
+/** Get the version of the peer's table we have applied. */
+unsigned int NeighbourChangeLog::received( unsigned int peer ) const {
+
+	VersionMap::const_iterator it = mReceived.find( peer );
+	return it == mReceived.end() ? 0 : it->second;
+
+}
+
+
+
+/** Record the version of the peer's table we have applied. */
+void NeighbourChangeLog::setReceived( unsigned int peer, unsigned int version ) {
+
+	mReceived[peer] = version;
+
+}
+
+
+
+/** Forget everything about a peer. Its next delta will be the whole table. */
+void NeighbourChangeLog::forgetPeer( unsigned int peer ) {
+
+	mAcknowledged.erase( peer );
+	mReceived.erase( peer );
+	pruneRemovals();
+
+}
+
+
+
+/** Log a change, replacing the node's previous one. */
+void NeighbourChangeLog::record( unsigned int id, bool removed ) {
+
+	std::pair<VersionMap::iterator,bool> r = mEntryVersion.insert( VersionMap::value_type( id, 0 ) );
+	if ( !r.second ) {
+		mChanges.erase( r.first->second );
+		mRemovals.erase( r.first->second );
+	}
+
+	Change c;
+	c.mId = id;
+	c.mRemoved = removed;
+	r.first->second = ++mVersion;
+	mChanges[mVersion] = c;
+	if ( removed )
+		mRemovals[mVersion] = id;
+
+}
+
+
+
+/** Drop removals that every peer has acknowledged, and the oldest ones beyond MAX_REMOVALS. */
+void NeighbourChangeLog::pruneRemovals() {
+
+	if ( mRemovals.empty() )
+		return;
+
+	// Peers that have been sent entries but acknowledged nothing are in mAcknowledged at 0, so they keep every removal.
+	unsigned int oldest = mVersion;
+	for ( VersionMap::const_iterator it = mAcknowledged.begin(); it != mAcknowledged.end(); it++ )
+		if ( it->second < oldest )
+			oldest = it->second;
+
+	while ( !mRemovals.empty() && ( mRemovals.begin()->first <= oldest || mRemovals.size() > MAX_REMOVALS ) ) {
+		VersionMap::iterator it = mRemovals.begin();
+		mChanges.erase( it->first );
+		mEntryVersion.erase( it->second );
+		mRemovals.erase( it );
+	}
+
+}
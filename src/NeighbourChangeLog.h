@@ -0,0 +1,113 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __CLUSTERLIB_NEIGHBOURCHANGELOG_H_
+#define __CLUSTERLIB_NEIGHBOURCHANGELOG_H_
+
+#include <map>
+
+
+/**
+ * Version log of a neighbour table, used to send a peer only the entries
+ * that changed since the peer last acknowledged the table.
+ *
+ * Every change to an entry, including its removal, takes the next version
+ * number, and the log keeps the latest change of each node ordered by
+ * version. A peer that has acknowledged version v needs exactly the
+ * changes after v; a peer that has acknowledged nothing (version 0) gets
+ * every entry. Deltas are cumulative, so a lost frame costs nothing but a
+ * larger delta next time.
+ *
+ * The log also records, for each peer, the version of the peer's table we
+ * have applied, which is sent back to it as its acknowledgement.
+ *
+ * Removals are kept until every peer we have sent entries to has
+ * acknowledged them. A peer that has been sent entries but has not
+ * acknowledged any counts as having acknowledged version 0.
+ */
+class NeighbourChangeLog {
+
+public:
+
+	/**
+	 * @brief The latest change to a node's entry.
+	 */
+	struct Change {
+		unsigned int mId;		/**< ID of the node. */
+		bool mRemoved;			/**< Was the entry removed? */
+	};
+
+	typedef std::map<unsigned int,Change> ChangeMap;
+	typedef ChangeMap::const_iterator const_iterator;
+
+	/** Maximum number of removals kept for peers that have not acknowledged them. */
+	static const unsigned int MAX_REMOVALS = 256;
+
+	NeighbourChangeLog() : mVersion(0) {}
+
+	/** Record that the entry of the given node was added or changed. */
+	void touch( unsigned int id ) { record( id, false ); }
+
+	/** Record that the entry of the given node was removed. */
+	void remove( unsigned int id );
+
+	/** Get the current version of the table. */
+	unsigned int version() const { return mVersion; }
+
+	/** Get the first change after the given version. Changes are visited in version order. */
+	const_iterator changesAfter( unsigned int version ) const { return mChanges.upper_bound( version ); }
+
+	/** Get the end of the changes. */
+	const_iterator end() const { return mChanges.end(); }
+
+	/** Get the version of our table the peer has acknowledged. */
+	unsigned int acknowledged( unsigned int peer ) const;
+
+	/** Record the version of our table the peer has acknowledged. */
+	void setAcknowledged( unsigned int peer, unsigned int version );
+
+	/** Record that entries have been sent to the peer, so removals are kept until it acknowledges them. */
+	void setSent( unsigned int peer ) { mAcknowledged.insert( VersionMap::value_type( peer, 0 ) ); }
+
+	/** Get the version of the peer's table we have applied. */
+	unsigned int received( unsigned int peer ) const;
+
+	/** Record the version of the peer's table we have applied. */
+	void setReceived( unsigned int peer, unsigned int version );
+
+	/** Forget everything about a peer. Its next delta will be the whole table. */
+	void forgetPeer( unsigned int peer );
+
+protected:
+
+	typedef std::map<unsigned int,unsigned int> VersionMap;
+
+	unsigned int mVersion;				/**< Version of the latest change. */
+	ChangeMap mChanges;					/**< Latest change of each node, by version. */
+	VersionMap mEntryVersion;			/**< Version of the latest change of each node. */
+	VersionMap mRemovals;				/**< ID of each removal in mChanges, by version. */
+	VersionMap mAcknowledged;			/**< Version of our table acknowledged by each peer we have sent entries to. */
+	VersionMap mReceived;				/**< Version of each peer's table we have applied. */
+
+	/** Log a change, replacing the node's previous one. */
+	void record( unsigned int id, bool removed );
+
+	/** Drop removals that every peer has acknowledged, and the oldest ones beyond MAX_REMOVALS. */
+	void pruneRemovals();
+
+};
+
+
+#endif
@@ -0,0 +1,187 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "NeighbourGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+
+/** Set the width of a cell. This clears the grid. */
+void NeighbourGrid::setCellSize( double cellSize ) {
+
+	clear();
+	mCellSize = cellSize;
+
+}
+
+
+
+/** Set the position of a neighbour, adding it if it is not in the grid. */
+void NeighbourGrid::set( unsigned int id, const Coord &pos ) {
+
+	CellKey key = cellOf( pos.x, pos.y );
+	MemberIndex::iterator it = mIndex.find( id );
+	if ( it != mIndex.end() ) {
+		if ( it->second.first == key ) {
+			Member &m = mCells[key][it->second.second];
+			m.mX = pos.x;
+			m.mY = pos.y;
+			return;
+		}
+		erase( id );
+	}
+
+	Member m;
+	m.mId = id;
+	m.mX = pos.x;
+	m.mY = pos.y;
+	Cell &cell = mCells[key];
+	mIndex[id] = std::make_pair( key, (unsigned int)cell.size() );
+	cell.push_back( m );
+
+}
+
+
+
+/** Remove a neighbour. */
+void NeighbourGrid::erase( unsigned int id ) {
+
+	MemberIndex::iterator it = mIndex.find( id );
+	if ( it == mIndex.end() )
+		return;
+
+	// Fill the hole with the last member of the cell so it stays dense.
+	CellMap::iterator c = mCells.find( it->second.first );
+	Cell &cell = c->second;
+	unsigned int slot = it->second.second;
+	if ( slot != cell.size() - 1 ) {
+		cell[slot] = cell.back();
+		mIndex[cell[slot].mId].second = slot;
+	}
+	cell.pop_back();
+	if ( cell.empty() )
+		mCells.erase( c );
+	mIndex.erase( it );
+
+}
+
+
+
+/** Append the IDs of the neighbours within the given distance of a point to the list, in no particular order. */
+void NeighbourGrid::withinRadius( const Coord &centre, double radius, std::vector<unsigned int> &ids ) const {
+
+	CellKey low = cellOf( centre.x - radius, centre.y - radius );
+	CellKey high = cellOf( centre.x + radius, centre.y + radius );
+	double radiusSq = radius * radius;
+
+	// Walk the cells in range; a sparse grid may have fewer non-empty cells than that, so walk those instead.
+	if ( (double)( high.first - low.first + 1 ) * ( high.second - low.second + 1 ) > mCells.size() ) {
+		for ( CellMap::const_iterator c = mCells.begin(); c != mCells.end(); c++ ) {
+			for ( Cell::const_iterator m = c->second.begin(); m != c->second.end(); m++ ) {
+				double dx = m->mX - centre.x, dy = m->mY - centre.y;
+				if ( dx*dx + dy*dy <= radiusSq )
+					ids.push_back( m->mId );
+			}
+		}
+		return;
+	}
+
+	for ( int i = low.first; i <= high.first; i++ ) {
+		// Cells are ordered by column then row, so each column is one contiguous range of the map.
+		CellMap::const_iterator c = mCells.lower_bound( CellKey( i, low.second ) );
+		CellMap::const_iterator end = mCells.upper_bound( CellKey( i, high.second ) );
+		for ( ; c != end; c++ ) {
+			for ( Cell::const_iterator m = c->second.begin(); m != c->second.end(); m++ ) {
+				double dx = m->mX - centre.x, dy = m->mY - centre.y;
+				if ( dx*dx + dy*dy <= radiusSq )
+					ids.push_back( m->mId );
+			}
+		}
+	}
+
+}
+
+
+
+/** Write the IDs of the k neighbours nearest to a point to the list, nearest first. Ties go to the lowest ID. */
+void NeighbourGrid::nearest( const Coord &centre, unsigned int k, std::vector<unsigned int> &ids ) const {
+
+	ids.clear();
+	k = std::min( k, size() );
+	if ( k == 0 )
+		return;
+
+	std::vector<Candidate> candidates;
+	CellKey home = cellOf( centre.x, centre.y );
+
+	// Anything outside ring r of cells is at least r cells from the point, so stop once k candidates are nearer than that.
+	// If the rings would cover more cells than are occupied, look at every neighbour instead.
+	for ( int r = 0; ; r++ ) {
+
+		if ( (double)( 2*r + 1 ) * ( 2*r + 1 ) > mCells.size() ) {
+			candidates.clear();
+			for ( CellMap::const_iterator c = mCells.begin(); c != mCells.end(); c++ )
+				collect( c->second, centre.x, centre.y, candidates );
+			break;
+		}
+
+		for ( int i = home.first - r; i <= home.first + r; i++ ) {
+			// The top and bottom rows of the ring are whole; the sides are one cell each.
+			int step = ( i == home.first - r || i == home.first + r ) ? 1 : 2 * r;
+			for ( int j = home.second - r; j <= home.second + r; j += step ) {
+				CellMap::const_iterator c = mCells.find( CellKey( i, j ) );
+				if ( c != mCells.end() )
+					collect( c->second, centre.x, centre.y, candidates );
+			}
+		}
+
+		if ( candidates.size() >= k ) {
+			std::nth_element( candidates.begin(), candidates.begin() + k - 1, candidates.end() );
+			double reach = r * mCellSize;
+			if ( candidates[k-1].first <= reach * reach )
+				break;
+		}
+
+	}
+
+	std::partial_sort( candidates.begin(), candidates.begin() + k, candidates.end() );
+	ids.resize( k );
+	for ( unsigned int i = 0; i < k; i++ )
+		ids[i] = candidates[i].second;
+
+}
+
+
+
+/** Get the cell holding a point. */
+NeighbourGrid::CellKey NeighbourGrid::cellOf( double x, double y ) const {
+
+	return CellKey( (int)floor( x / mCellSize ), (int)floor( y / mCellSize ) );
+
+}
+
+
+
+/** Add the members of a cell to the list of candidates, with their squared distances from a point. */
+void NeighbourGrid::collect( const Cell &cell, double x, double y, std::vector<Candidate> &candidates ) {
+
+	for ( Cell::const_iterator m = cell.begin(); m != cell.end(); m++ ) {
+		double dx = m->mX - x, dy = m->mY - y;
+		candidates.push_back( Candidate( dx*dx + dy*dy, m->mId ) );
+	}
+
+}
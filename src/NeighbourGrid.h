@@ -0,0 +1,95 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __CLUSTERLIB_NEIGHBOURGRID_H_
+#define __CLUSTERLIB_NEIGHBOURGRID_H_
+
+#include <Coord.h>
+
+#include <vector>
+#include <map>
+
+
+/**
+ * Uniform grid over the positions of the neighbours in a neighbour table,
+ * used to find the neighbours near a point without measuring the distance
+ * to every one.
+ *
+ * Space is divided into square cells, normally one transmit range wide.
+ * Each cell keeps the IDs and coordinates of its neighbours in a dense
+ * array, and an index maps each neighbour to its cell and slot, so moving
+ * or erasing a neighbour costs a couple of map lookups. A radius query
+ * scans only the cells that overlap the circle. A k-nearest query scans
+ * rings of cells outwards from the point until no unscanned cell can hold
+ * anything nearer.
+ */
+class NeighbourGrid {
+
+public:
+
+	NeighbourGrid() : mCellSize(1) {}
+
+	/** Set the width of a cell. This clears the grid. */
+	void setCellSize( double cellSize );
+
+	/** Set the position of a neighbour, adding it if it is not in the grid. */
+	void set( unsigned int id, const Coord &pos );
+
+	/** Remove a neighbour. */
+	void erase( unsigned int id );
+
+	/** Remove all neighbours. */
+	void clear() { mIndex.clear(); mCells.clear(); }
+
+	/** Get the number of neighbours in the grid. */
+	unsigned int size() const { return mIndex.size(); }
+
+	/** Append the IDs of the neighbours within the given distance of a point to the list, in no particular order. */
+	void withinRadius( const Coord &centre, double radius, std::vector<unsigned int> &ids ) const;
+
+	/** Write the IDs of the k neighbours nearest to a point to the list, nearest first. Ties go to the lowest ID. */
+	void nearest( const Coord &centre, unsigned int k, std::vector<unsigned int> &ids ) const;
+
+protected:
+
+	/**
+	 * @brief A neighbour in a cell.
+	 */
+	struct Member {
+		unsigned int mId;		/**< ID of the neighbour. */
+		double mX;				/**< X coordinate of the neighbour. */
+		double mY;				/**< Y coordinate of the neighbour. */
+	};
+
+	typedef std::pair<int,int> CellKey;
+	typedef std::vector<Member> Cell;
+	typedef std::map<CellKey,Cell> CellMap;
+	typedef std::map<unsigned int,std::pair<CellKey,unsigned int> > MemberIndex;
+	typedef std::pair<double,unsigned int> Candidate;
+
+	double mCellSize;				/**< Width of a cell. */
+	CellMap mCells;					/**< Neighbours in each non-empty cell. */
+	MemberIndex mIndex;				/**< Cell and slot of each neighbour. */
+
+	/** Get the cell holding a point. */
+	CellKey cellOf( double x, double y ) const;
+
+	/** Add the members of a cell to the list of candidates, with their squared distances from a point. */
+	static void collect( const Cell &cell, double x, double y, std::vector<Candidate> &candidates );
+
+};
+
+
+#endif
@@ -0,0 +1,94 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "NeighbourSelection.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+
+/** Get the priority named by a module parameter. Returns false if the name is unknown. */
+bool NeighbourSelection::parse( const std::string &name, Priority &priority ) {
+
+	if ( name == "id" )
+		priority = ID;
+	else if ( name == "freshest" )
+		priority = FRESHEST;
+	else if ( name == "let" )
+		priority = LONGEST_LINK;
+	else if ( name == "hops" )
+		priority = FEWEST_HOPS;
+	else if ( name == "nearest" )
+		priority = NEAREST;
+	else
+		return false;
+	return true;
+
+}
+
+
+
+/** Add a candidate. */
+void NeighbourSelection::add( unsigned int id, double timeStamp, double linkExpirationTime, unsigned int hopCount, double distance ) {
+
+	Candidate c;
+	c.mId = id;
+	switch ( mPriority ) {
+		case FRESHEST:
+			c.mCost = -timeStamp;
+			break;
+		case LONGEST_LINK:
+			// A LET of 0/0 comes from two nodes with the same velocity, whose link never expires.
+			c.mCost = linkExpirationTime != linkExpirationTime ? -HUGE_VAL : -linkExpirationTime;
+			break;
+		case FEWEST_HOPS:
+			c.mCost = hopCount;
+			break;
+		case NEAREST:
+			c.mCost = distance;
+			break;
+		default:
+			c.mCost = 0;
+			break;
+	}
+	mCandidates.push_back( c );
+
+}
+
+
+
+/** Write the IDs of at most k candidates to the given list, best first. */
+void NeighbourSelection::select( std::vector<unsigned int> &ids, unsigned int k ) {
+
+	k = std::min<unsigned int>( k, mCandidates.size() );
+	std::partial_sort( mCandidates.begin(), mCandidates.begin() + k, mCandidates.end(), before );
+
+	ids.resize( k );
+	for ( unsigned int i = 0; i < k; i++ )
+		ids[i] = mCandidates[i].mId;
+
+}
+
+
+
+/** Check whether candidate a should be sent before candidate b. */
+bool NeighbourSelection::before( const Candidate &a, const Candidate &b ) {
+
+	if ( a.mCost != b.mCost )
+		return a.mCost < b.mCost;
+	return a.mId < b.mId;
+
+}
@@ -0,0 +1,85 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __CLUSTERLIB_NEIGHBOURSELECTION_H_
+#define __CLUSTERLIB_NEIGHBOURSELECTION_H_
+
+#include <string>
+#include <vector>
+
+
+/**
+ * Chooses which neighbour table entries to send when they do not all fit
+ * in a frame.
+ *
+ * Each candidate is reduced to a single cost when it is added, according
+ * to the priority in use, and the cheapest k are picked with a partial
+ * sort, so choosing costs O(n log k) rather than a full sort. Equal costs
+ * are broken by node ID, lowest first. Under ID priority every cost is
+ * equal, which picks the lowest IDs, as walking the neighbour table in key
+ * order and stopping when the frame is full would.
+ */
+class NeighbourSelection {
+
+public:
+
+	/**
+	 * @brief The entries to prefer when the frame is full.
+	 */
+	enum Priority {
+		ID,					/**< Lowest node ID. */
+		FRESHEST,			/**< Most recently updated. */
+		LONGEST_LINK,		/**< Longest link expiration time. */
+		FEWEST_HOPS,		/**< Fewest hops away. */
+		NEAREST				/**< Nearest to the receiver. */
+	};
+
+	/**
+	 * @brief The selection key of one candidate.
+	 */
+	struct Candidate {
+		double mCost;		/**< Cost of the candidate; cheapest is sent first. */
+		unsigned int mId;	/**< ID of the candidate. */
+	};
+
+	NeighbourSelection( Priority priority ) : mPriority( priority ) {}
+
+	/** Get the priority named by a module parameter. Returns false if the name is unknown. */
+	static bool parse( const std::string &name, Priority &priority );
+
+	/** Add a candidate. */
+	void add( unsigned int id, double timeStamp, double linkExpirationTime, unsigned int hopCount, double distance );
+
+	/** Get the number of candidates. */
+	unsigned int size() const { return mCandidates.size(); }
+
+	/** Remove all candidates. */
+	void clear() { mCandidates.clear(); }
+
+	/** Write the IDs of at most k candidates to the given list, best first. */
+	void select( std::vector<unsigned int> &ids, unsigned int k );
+
+	/** Check whether candidate a should be sent before candidate b. */
+	static bool before( const Candidate &a, const Candidate &b );
+
+protected:
+
+	Priority mPriority;						/**< The entries to prefer. */
+	std::vector<Candidate> mCandidates;		/**< Keys of the candidates. */
+
+};
+
+
+#endif
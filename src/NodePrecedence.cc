@@ -0,0 +1,92 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "NodePrecedence.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+NodePrecedence::NodePrecedence( unsigned int connectionLimit, double distanceThreshold, double timeThreshold ) :
+	mConnectionLimit( connectionLimit ),
+	mDistanceThreshold( distanceThreshold ),
+	mTimeThreshold( timeThreshold ) {
+}
+
+
+
+/** Add a candidate. */
+void NodePrecedence::add( unsigned int id, unsigned int connectionCount, double distance, double linkExpirationTime, unsigned int routeSimilarity ) {
+
+	// A LET of 0/0 comes from two nodes with the same velocity, whose link never expires.
+	if ( linkExpirationTime != linkExpirationTime )
+		linkExpirationTime = HUGE_VAL;
+
+	Candidate c;
+	c.mId = id;
+	c.mRouteSimilarity = routeSimilarity;
+	c.mAtLimit = connectionCount >= mConnectionLimit;
+	c.mDistanceBand = band( distance, mDistanceThreshold );
+	c.mTimeBand = band( linkExpirationTime, mTimeThreshold );
+	c.mConnectionCount = connectionCount;
+	mCandidates.push_back( c );
+
+}
+
+
+
+/** Write the candidate IDs to the given list, highest precedence first. */
+void NodePrecedence::rank( std::vector<unsigned int> &ids, unsigned int k ) {
+
+	if ( k > 0 && k < mCandidates.size() )
+		std::partial_sort( mCandidates.begin(), mCandidates.begin() + k, mCandidates.end(), precedes );
+	else
+		std::sort( mCandidates.begin(), mCandidates.end(), precedes );
+
+	ids.resize( mCandidates.size() );
+	for ( unsigned int i = 0; i < mCandidates.size(); i++ )
+		ids[i] = mCandidates[i].mId;
+
+}
+
+
+
+/** Check whether candidate a has higher precedence than candidate b. */
+bool NodePrecedence::precedes( const Candidate &a, const Candidate &b ) {
+
+	if ( a.mRouteSimilarity != b.mRouteSimilarity )
+		return a.mRouteSimilarity > b.mRouteSimilarity;
+	if ( a.mAtLimit != b.mAtLimit )
+		return b.mAtLimit;
+	if ( a.mDistanceBand != b.mDistanceBand )
+		return a.mDistanceBand < b.mDistanceBand;
+	if ( a.mTimeBand != b.mTimeBand )
+		return a.mTimeBand > b.mTimeBand;
+	if ( a.mConnectionCount != b.mConnectionCount )
+		return a.mConnectionCount > b.mConnectionCount;
+	return a.mId < b.mId;
+
+}
+
+
+
+/** Get the band a value falls in. A non-positive width compares the raw values. */
+double NodePrecedence::band( double value, double width ) {
+
+	if ( width <= 0 )
+		return value;
+	return floor( value / width );
+
+}
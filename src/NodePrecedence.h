@@ -0,0 +1,89 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __CLUSTERLIB_NODEPRECEDENCE_H_
+#define __CLUSTERLIB_NODEPRECEDENCE_H_
+
+#include <vector>
+
+
+/**
+ * Ranks candidate cluster heads with the Node Precedence Algorithm (NPA).
+ *
+ * The keys of each candidate are copied into a contiguous array when it is
+ * added, so ranking never goes back to the neighbour table. Candidates are
+ * ordered by, in turn:
+ *  - route similarity, highest first (only used by CRAC; zero otherwise),
+ *  - whether the candidate has reached the connection limit, those that
+ *    have not first,
+ *  - distance, nearest first, in bands of the distance threshold,
+ *  - link expiration time, longest first, in bands of the time threshold,
+ *  - connection count, highest first,
+ *  - node ID, lowest first.
+ *
+ * Comparing distances and LETs in whole bands, rather than by whether two
+ * candidates differ by more than the threshold, makes this a total order,
+ * so the result does not depend on how the sort visits the candidates.
+ */
+class NodePrecedence {
+
+public:
+
+	/**
+	 * @brief The ranking keys of one candidate.
+	 */
+	struct Candidate {
+		unsigned int mId;				/**< ID of the candidate. */
+		unsigned int mRouteSimilarity;	/**< Route similarity to us. */
+		bool mAtLimit;					/**< Has the candidate reached the connection limit? */
+		double mDistanceBand;			/**< Distance from us, in units of the distance threshold. */
+		double mTimeBand;				/**< Link expiration time, in units of the time threshold. */
+		unsigned int mConnectionCount;	/**< Number of connections the candidate has. */
+	};
+
+	NodePrecedence( unsigned int connectionLimit, double distanceThreshold, double timeThreshold );
+
+	/** Add a candidate. */
+	void add( unsigned int id, unsigned int connectionCount, double distance, double linkExpirationTime, unsigned int routeSimilarity = 0 );
+
+	/** Get the number of candidates. */
+	unsigned int size() const { return mCandidates.size(); }
+
+	/** Remove all candidates. */
+	void clear() { mCandidates.clear(); }
+
+	/**
+	 * Write the candidate IDs to the given list, highest precedence first.
+	 * If k is non-zero, only the first k are guaranteed to be in order.
+	 */
+	void rank( std::vector<unsigned int> &ids, unsigned int k = 0 );
+
+	/** Check whether candidate a has higher precedence than candidate b. */
+	static bool precedes( const Candidate &a, const Candidate &b );
+
+protected:
+
+	unsigned int mConnectionLimit;			/**< Maximum number of connections of a CH. */
+	double mDistanceThreshold;				/**< Width of a distance band. */
+	double mTimeThreshold;					/**< Width of a LET band. */
+	std::vector<Candidate> mCandidates;		/**< Keys of the candidates. */
+
+	/** Get the band a value falls in. A non-positive width compares the raw values. */
+	static double band( double value, double width );
+
+};
+
+
+#endif
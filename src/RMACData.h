@@ -43,6 +43,7 @@ typedef NeighbourEntrySet::iterator NeighbourEntrySetIterator;
 typedef std::vector<unsigned int> NeighbourIdSet;
 typedef NeighbourIdSet::iterator NeighbourIdSetIterator;
 
+/** A route as a list of SUMO edge names. Routes are sent and compared as EdgeRoute. */
 typedef std::list<std::string> Route;
 
 #endif /* #define RMACDATA_H_ */
@@ -37,6 +37,7 @@
 #include "ClusterAnalysisScenarioManager.h"
 #include "RmacNetworkLayer.h"
 #include "RMACData.h"
+#include "NodePrecedence.h"
 
 
 Define_Module(RmacNetworkLayer);
@@ -143,6 +144,10 @@ void RmacNetworkLayer::ClusterStarted() {
 void RmacNetworkLayer::ClusterMemberAdded( int id ) {
 
 	ClusterAlgorithm::ClusterMemberAdded(id);
+	mClusterMemberIndex.insert( id );
+	NeighbourIterator it = mNeighbours.find( id );
+	if ( it != mNeighbours.end() )
+		mClusterExtent.set( id, it->second.mPosition );
 	// TODO: Assess changes to hierarchy and propagate them.
 	NodeIdList record;
 	UpdateLevelOfMember( id, record, false );
@@ -155,6 +160,8 @@ void RmacNetworkLayer::ClusterMemberAdded( int id ) {
 void RmacNetworkLayer::ClusterMemberRemoved( int id ) {
 
 	ClusterAlgorithm::ClusterMemberRemoved(id);
+	mClusterMemberIndex.erase( id );
+	mClusterExtent.erase( id );
 	// Assess changes to hierarchy and propagate them.
 	NodeIdList record;
 	UpdateLevelOfMember( id, record, true );
@@ -179,6 +186,7 @@ void RmacNetworkLayer::ClusterDied( int deathType ) {
 		Process();
 	}
 	mMaximumLevels = mCurrentLevels = 0;
+	mBranchDepths.clear();
 	if ( mPollTriggerMessage->isScheduled() )
 		cancelEvent( mPollTriggerMessage );
 	if ( mPollPeriodFinishedMessage->isScheduled() )
@@ -208,6 +216,7 @@ void RmacNetworkLayer::initialize(int stage)
         ChannelAccess *channelAccess = FindModule<ChannelAccess*>::findSubModule(findHost());
         mZoneOfInterest = 2 * channelAccess->getConnectionManager( channelAccess->getParentModule() )->getMaxInterferenceDistance();
         mTransmitRangeSq = pow( mZoneOfInterest/2, 2 );
+        mNeighbourGrid.setCellSize( mZoneOfInterest/2 );
 
         // get parameters
         mConnectionLimits = par("connectionLimits").longValue();
@@ -219,6 +228,15 @@ void RmacNetworkLayer::initialize(int stage)
         mPollInterval = par("pollInterval").doubleValue();
         mPollTimeout = par("pollTimeout").doubleValue();
         mMissedPingThreshold = par("missedPingThreshold").longValue();
+        mClusterSummaryRate = par("clusterSummaryFalsePositiveRate").doubleValue();
+        if ( mClusterSummaryRate < 0 || mClusterSummaryRate >= 1 )
+        	throw cRuntimeError( "clusterSummaryFalsePositiveRate must be in [0,1)!" );
+        if ( par("clusterSummaryMaxBits").longValue() < 0 )
+        	throw cRuntimeError( "clusterSummaryMaxBits must not be negative!" );
+        mClusterSummaryMaxBits = par("clusterSummaryMaxBits").longValue();
+        if ( !NeighbourSelection::parse( par("neighbourTablePriority").stdstringValue(), mNeighbourTablePriority ) )
+        	throw cRuntimeError( "Unknown neighbourTablePriority: %s", par("neighbourTablePriority").stringValue() );
+        mDeltaNeighbourTables = par("deltaNeighbourTables").boolValue();
 
         // Setup messages
         // Phase 1 clustering messages
@@ -241,6 +259,7 @@ void RmacNetworkLayer::initialize(int stage)
       	scheduleAt( simTime() + float(rand()) / RAND_MAX, mFirstTimeProcess );
 
       	mMaximumLevels = mCurrentLevels = 0;
+      	mBranchDepths.clear();
 
 		// set up result collection
 		mSigClusterDepth = registerSignal( "sigClusterDepth" );
@@ -501,14 +520,17 @@ void RmacNetworkLayer::handleLowerMsg(cMessage* msg) {
         		break;	// Ignore this command if it's from a different CH.
         	}
 
-        	// Get the cluster member table out of the frame.
-        	mTemporaryClusterRecord.clear();
-        	//std::cerr << mId << ": Sending cluster presence message with cluster table: [";
-        	for ( NeighbourIdSetIterator it = m->getNeighbourIdTable().begin(); it != m->getNeighbourIdTable().end(); it++ ) {
-        		mTemporaryClusterRecord.insert(*it);
-        		//std::cerr << *it << " ";
+        	// Get the cluster member table or summary out of the frame.
+        	mClusterSummary = m->getClusterSummary();
+        	if ( mClusterSummary.empty() ) {
+	        	mTemporaryClusterRecord.clear();
+	        	//std::cerr << mId << ": Sending cluster presence message with cluster table: [";
+	        	for ( NeighbourIdSetIterator it = m->getNeighbourIdTable().begin(); it != m->getNeighbourIdTable().end(); it++ ) {
+	        		mTemporaryClusterRecord.insert(*it);
+	        		//std::cerr << *it << " ";
+	        	}
+	        	//std::cerr << "]\n";
         	}
-        	//std::cerr << "]\n";
 
         	BroadcastClusterPresence();
 
@@ -689,9 +711,11 @@ void RmacNetworkLayer::handleSelfMsg(cMessage* msg) {
     	for ( NodeIdSet::iterator it = mWaitingPollAcks.begin(); it != mWaitingPollAcks.end(); it++ ) {
     		// Increment the missed ping counter.
     		mNeighbours[*it].mMissedPings++;
+    		if ( mDeltaNeighbourTables )
+    			mNeighbourLog.touch( *it );
     		if ( mNeighbours[*it].mMissedPings >= (int)mMissedPingThreshold ) {
 				// Remove from both the neighbour table and the cluster
-				mNeighbours.erase(*it);
+				RemoveNeighbour( *it );
 				ClusterMemberRemoved(*it);
     		}
     	}
@@ -814,9 +838,12 @@ bool RmacNetworkLayer::Process( cMessage *msg ) {
 				} else {
 
 					// We have a set of one hop neighbours. Apply the NPA.
-					NPA predicate;
-					predicate.mClient = this;
-					std::sort( mOneHopNeighbours.begin(), mOneHopNeighbours.end(), predicate );
+					NodePrecedence npa( GetConnectionLimits(), GetDistanceThreshold(), GetTimeThreshold() );
+					for ( unsigned int i = 0; i < mOneHopNeighbours.size(); i++ ) {
+						const Neighbour &n = GetNeighbour( mOneHopNeighbours[i] );
+						npa.add( n.mId, n.mConnectionCount, n.mDistanceToNode, n.mLinkExpirationTime );
+					}
+					npa.rank( mOneHopNeighbours );
 					//std::cerr << mId << ": Have " << mOneHopNeighbours.size() << " 1-hop neighbours. Entering JOIN phase.\n";
 
 					// Now go to the joining phase.
@@ -857,7 +884,7 @@ bool RmacNetworkLayer::Process( cMessage *msg ) {
 					//std::cerr << mId << ": JOIN timeout!\n";
 					// The JOIN timeout occurred. We must have gone out of range of this neighbour.
 					// We erase this from the neighbour table as well as the one-hop neighbours.
-					mNeighbours.erase( mOneHopNeighbours[0] );
+					RemoveNeighbour( mOneHopNeighbours[0] );
 					mOneHopNeighbours.erase( mOneHopNeighbours.begin() );
 				} else if ( msg == mJoinDenyMessage ) {
 					//std::cerr << mId << ": JOIN denied!\n";
@@ -893,7 +920,7 @@ bool RmacNetworkLayer::Process( cMessage *msg ) {
 			    	// We haven't heard from the CH in a while.
 		    		//std::cerr << mId << ": POLL timeout, leaving " << mClusterHead << std::endl;
 		    		mClusterHierarchy.clear();
-		    		mNeighbours.erase(mClusterHead);
+		    		RemoveNeighbour( mClusterHead );
 		    		mClusterHead = -1;
 		    		if ( mCurrentState == CLUSTER_MEMBER ) {
 			    		if ( mProcessState == UNIFYING )
@@ -952,7 +979,7 @@ void RmacNetworkLayer::GetOneHopNeighbours() {
 bool RmacNetworkLayer::EvaluateClusterPresence( RmacControlMessage *m ) {
 
 	// First let's check if the sending node is in our cluster.
-	if ( ListHasValue( mClusterMembers, m->getNodeId() ) )
+	if ( mClusterMemberIndex.contains( m->getNodeId() ) )
 		return false;	// Connected cluster
 
 	//std::cerr << mId << ": Looking for intersection between [";
@@ -964,11 +991,18 @@ bool RmacNetworkLayer::EvaluateClusterPresence( RmacControlMessage *m ) {
 		std::cerr << *it << " ";
 	std::cerr << "]\n";*/
 
-	// Check if there are any common neighbours.
-	NodeIdSet::iterator it = mClusterMembers.begin();
-	for ( it = mClusterMembers.begin(); it != mClusterMembers.end(); it++ )
-		if( ListHasValue( m->getNeighbourIdTable(), *it ) )
-			return false;
+	// Check if there are any common neighbours. A false positive from a summary makes the clusters look connected.
+	const BloomFilter &summary = m->getClusterSummary();
+	if ( !summary.empty() ) {
+		for ( NodeIdSet::iterator it = mClusterMembers.begin(); it != mClusterMembers.end(); it++ )
+			if ( summary.mayContain( *it ) )
+				return false;
+		return true;
+	}
+
+	// Senders fill the table from a set, so it is sorted.
+	if ( mClusterMemberIndex.intersects( m->getNeighbourIdTable() ) )
+		return false;
 
 	return true;
 
@@ -1016,28 +1050,51 @@ void RmacNetworkLayer::SendControlMessage( int type, int id, int role ) {
 
     	coreEV << "POLL" << ( type == POLL_ACK_MESSAGE ? "_ACK" : "" );
 
-    	NeighbourEntrySet &pSet = pkt->getNeighbourTable();
-    	for ( NeighbourIterator it = mNeighbours.begin(); it != mNeighbours.end(); it++ ) {
-
-    		if ( it->second.mId == id || it->second.mProviderId == id )
-				continue;
-			if ( it->second.mPosition.distance( mNeighbours[id].mPosition ) > mZoneOfInterest )
-				continue;
-    		NeighbourEntry e;
-    		e.mId = it->second.mId;
-    		e.mNetworkAddress = it->second.mNetworkAddress;
-    		e.mPositionX = it->second.mPosition.x;
-    		e.mPositionY = it->second.mPosition.y;
-    		e.mVelocityX = it->second.mVelocity.x;
-    		e.mVelocityY = it->second.mVelocity.y;
-            e.mConnectionCount = it->second.mConnectionCount;
-            e.mHopCount = it->second.mHopCount+1;
-            e.mMissedPings = it->second.mMissedPings;
-            e.mTimeStamp = it->second.mTimeStamp;
-            pSet.push_back(e);
-            s += 328;
-            if ( s + 328 > 18496 )
-            	break;
+    	if ( mDeltaNeighbourTables ) {
+
+    		// Send only the changes since the version of our table the receiver has acknowledged.
+    		unsigned int base = mNeighbourLog.acknowledged( id );
+    		unsigned int version = base;
+    		NeighbourIdSet &removed = pkt->getRemovedNeighbours();
+    		s += 96;
+    		NeighbourChangeLog::const_iterator c = mNeighbourLog.changesAfter( base );
+    		for ( ; c != mNeighbourLog.end(); c++ ) {
+    			if ( s + 328 > 18496 )
+    				break;	// The receiver is only brought up to the last change that fits.
+    			if ( c->second.mRemoved ) {
+    				removed.push_back( c->second.mId );
+    				s += 8;
+    			} else if ( MapHasKey( mNeighbours, c->second.mId ) && RelaysNeighbour( mNeighbours[c->second.mId], id ) ) {
+    				AddNeighbourEntry( pkt, mNeighbours[c->second.mId] );
+    				s += 328;
+    			}
+    			version = c->first;
+    		}
+    		pkt->setTableBaseVersion( base );
+    		pkt->setTableVersion( version );
+    		pkt->setTableAckVersion( mNeighbourLog.received( id ) );
+    		mNeighbourLog.setSent( id );
+
+    	} else {
+
+	    	// Only the neighbours in the receiver's zone of interest are candidates.
+	    	// If the table doesn't fit, send the entries that matter most first.
+	    	NeighbourSelection selection( mNeighbourTablePriority );
+	    	Coord receiver = mNeighbours[id].mPosition;
+	    	std::vector<unsigned int> nearby;
+	    	mNeighbourGrid.withinRadius( receiver, mZoneOfInterest, nearby );
+	    	for ( unsigned int i = 0; i < nearby.size(); i++ ) {
+	    		NeighbourIterator it = mNeighbours.find( nearby[i] );
+	    		if ( RelaysNeighbour( it->second, id ) )
+	    			selection.add( it->first, SIMTIME_DBL( it->second.mTimeStamp ), it->second.mLinkExpirationTime, it->second.mHopCount, it->second.mPosition.distance( receiver ) );
+	    	}
+
+	    	std::vector<unsigned int> selected;
+	    	selection.select( selected, s < 18496 ? ( 18496 - s ) / 328 : 0 );
+	    	for ( unsigned int i = 0; i < selected.size(); i++ )
+	    		AddNeighbourEntry( pkt, mNeighbours[selected[i]] );
+	    	s += 328 * selected.size();
+
     	}
 
     	int sizeToAdd = 8 * ( mTemporaryClusterRecord.size() + mClusterHierarchy.size() + 1 );
@@ -1068,17 +1125,26 @@ void RmacNetworkLayer::SendControlMessage( int type, int id, int role ) {
     	else
     		coreEV << "CLUS_PRES";
 
-    	int sizeToAdd = 8 * ( mTemporaryClusterRecord.size() + mClusterHierarchy.size() + 1 );
+    	// Send the summary in place of the member list if it's enabled.
+    	bool sendSummary = mClusterSummaryRate > 0 && !mClusterSummary.empty();
+    	int sizeToAdd = 8 * ( mClusterHierarchy.size() + 1 );
+    	if ( sendSummary )
+    		sizeToAdd += mClusterSummary.bitLength();
+    	else
+    		sizeToAdd += 8 * mTemporaryClusterRecord.size();
     	if ( s + sizeToAdd < 18496 ) {
 
     		s += sizeToAdd;
 
-    		// Add the cluster record
-    		NeighbourIdSet &pIdSet = pkt->getNeighbourIdTable();
-			NodeIdSet::iterator it = mTemporaryClusterRecord.begin();
-	        for ( NodeIdSet::iterator it = mTemporaryClusterRecord.begin(); it != mTemporaryClusterRecord.end(); it++ ) {
-	        	pIdSet.push_back(*it);
-	        }
+    		if ( sendSummary ) {
+    			pkt->setClusterSummary( mClusterSummary );
+    		} else {
+	    		// Add the cluster record, in ascending order as EvaluateClusterPresence expects.
+	    		NeighbourIdSet &pIdSet = pkt->getNeighbourIdTable();
+		        for ( NodeIdSet::iterator it = mTemporaryClusterRecord.begin(); it != mTemporaryClusterRecord.end(); it++ ) {
+		        	pIdSet.push_back(*it);
+		        }
+    		}
 
 	        // Add the list of CHs in the hierarchy to the packet.
 	        NodeIdList &pList = pkt->getClusterHierarchy();
@@ -1233,35 +1299,30 @@ void RmacNetworkLayer::OrderClusterPresenceBroadcast() {
 	mTemporaryClusterRecord = mClusterMembers;
 	mTemporaryClusterRecord.insert(mId);
 
+	// Summarise them for the edge nodes, if enabled and either smaller than the list
+	// itself or needed because the list would not fit in the frame.
+	mClusterSummary = BloomFilter();
+	if ( mClusterSummaryRate > 0 ) {
+		BloomFilter summary( mTemporaryClusterRecord.size(), mClusterSummaryRate, mClusterSummaryMaxBits );
+		unsigned int listBits = 8 * mTemporaryClusterRecord.size();
+		bool listFits = 360 + 8 * ( mClusterHierarchy.size() + 1 ) + listBits < 18496;
+		if ( summary.bitLength() < listBits || !listFits ) {
+			for ( NodeIdSet::iterator it = mTemporaryClusterRecord.begin(); it != mTemporaryClusterRecord.end(); it++ )
+				summary.insert( *it );
+			mClusterSummary = summary;
+		}
+	}
+
 	// First determine cluster edge nodes
-	NodeIdSet::iterator it1, it2;
-	std::vector<NodePair> checkedPairs;
 	NodePair best(-1,-1);
-	double maxDist = 0;
-	Coord v = mMobility->getCurrentSpeed();
-	v = v / v.length();
 
 	if ( mClusterMembers.size() > 1 ) {
 
-		// For each member in the cluster.
-		for ( it1 = mTemporaryClusterRecord.begin(); it1 != mTemporaryClusterRecord.end(); it1++ ) {
-
-			// Go through all the other members in the cluster.
-			for ( it2 = mTemporaryClusterRecord.begin(); it2 != mTemporaryClusterRecord.end(); it2++ ) {
-				if ( *it1 == *it2 || ListHasValue(checkedPairs,NodePair(*it1,*it2)) || ListHasValue(checkedPairs,NodePair(*it2,*it1)) )
-					continue;
-				checkedPairs.push_back(NodePair(*it1,*it2));
-				Coord ab = ( mNeighbours[*it1].mPosition - mNeighbours[*it2].mPosition );
-				double d = ( ab.x*v.x + ab.y*v.y );
-				if ( d > maxDist ) {
-					maxDist = d;
-					best = checkedPairs.back();
-				}
-			}
-
-		}
+		// The edge nodes are the members furthest forward and back along our heading.
+		mClusterExtent.set( mId, mMobility->getCurrentPosition() );
+		mClusterExtent.edgeNodes( mMobility->getCurrentSpeed(), best.first, best.second );
 
-	} else {
+	} else if ( !mClusterMembers.empty() ) {
 
 		best = NodePair( mId, *mClusterMembers.begin() );
 
@@ -1359,8 +1420,19 @@ void RmacNetworkLayer::LeaveCluster() {
  */
 double RmacNetworkLayer::CalculateLinkExpirationTime( Coord pos, Coord vel ) {
 
-    Coord p = mMobility->getCurrentPosition();
-    Coord v = mMobility->getCurrentSpeed();
+    return CalculateLinkExpirationTime( pos, vel, mMobility->getCurrentPosition(), mMobility->getCurrentSpeed() );
+
+}
+
+/**
+ * @brief Calculate the Link Expiration Time, given the position and velocity of this node.
+ * @param[in] pos Position of the target node.
+ * @param[in] vel Velocity of the target node.
+ * @param[in] p Position of this node.
+ * @param[in] v Velocity of this node.
+ * @return The time until the link expires.
+ */
+double RmacNetworkLayer::CalculateLinkExpirationTime( const Coord &pos, const Coord &vel, const Coord &p, const Coord &v ) {
 
     double a = v.x - vel.x;
     double b = p.x - pos.x;
@@ -1379,50 +1451,107 @@ double RmacNetworkLayer::CalculateLinkExpirationTime( Coord pos, Coord vel ) {
 void RmacNetworkLayer::UpdateNeighbour( RmacControlMessage *m ) {
 
 	int id = m->getNodeId();
-    mNeighbours[id].mId = id;
-    mNeighbours[id].mPosition.x = m->getXPosition();
-    mNeighbours[id].mPosition.y = m->getYPosition();
-    mNeighbours[id].mVelocity.x = m->getXVelocity();
-    mNeighbours[id].mVelocity.y = m->getYVelocity();
-    mNeighbours[id].mIsClusterHead = m->getIsClusterHead();
-    mNeighbours[id].mClusterHead = m->getClusterHead();
-    mNeighbours[id].mConnectionCount = m->getConnectionCount();
-    mNeighbours[id].mNetworkAddress = m->getSrcAddr();
-    mNeighbours[id].mHopCount = 1;
-    mNeighbours[id].mProviderId = id;
-    mNeighbours[id].mDistanceToNode = mMobility->getCurrentPosition().distance( mNeighbours[id].mPosition );
-    mNeighbours[id].mLinkExpirationTime = CalculateLinkExpirationTime( mNeighbours[id].mPosition, mNeighbours[id].mVelocity );
-    mNeighbours[id].mTimeStamp = simTime();
-    mNeighbours[id].mMissedPings = 0;
-    mNeighbours[id].mDataOwner = this;
+	Coord ownPosition = mMobility->getCurrentPosition();
+	Coord ownVelocity = mMobility->getCurrentSpeed();
+
+	Neighbour &n = mNeighbours[id];
+    n.mId = id;
+    n.mPosition.x = m->getXPosition();
+    n.mPosition.y = m->getYPosition();
+    n.mVelocity.x = m->getXVelocity();
+    n.mVelocity.y = m->getYVelocity();
+    n.mIsClusterHead = m->getIsClusterHead();
+    n.mClusterHead = m->getClusterHead();
+    n.mConnectionCount = m->getConnectionCount();
+    n.mNetworkAddress = m->getSrcAddr();
+    n.mHopCount = 1;
+    n.mProviderId = id;
+    n.mDistanceToNode = ownPosition.distance( n.mPosition );
+    n.mLinkExpirationTime = CalculateLinkExpirationTime( n.mPosition, n.mVelocity, ownPosition, ownVelocity );
+    mNeighbourGrid.set( id, n.mPosition );
+    if ( mClusterMembers.find( id ) != mClusterMembers.end() )
+    	mClusterExtent.set( id, n.mPosition );
+    n.mTimeStamp = simTime();
+    n.mMissedPings = 0;
+    n.mDataOwner = this;
+    if ( mDeltaNeighbourTables )
+    	mNeighbourLog.touch( id );
 
 	NeighbourEntrySet &pSet = m->getNeighbourTable();
 	if ( !pSet.empty() ) {
 
+		// A table sent in ID order that is not much smaller than ours is merged with ours in one pass.
+		// Otherwise each entry is looked up on its own.
+		bool merge = pSet.size() * 8 >= mNeighbours.size();
+		for ( unsigned int i = 1; merge && i < pSet.size(); i++ )
+			merge = pSet[i-1].mId < pSet[i].mId;
+
+		NeighbourIterator pos = mNeighbours.begin();
 		NeighbourEntrySetIterator it = pSet.begin();
 		for ( ; it != pSet.end(); it++ ) {
 
-			if ( MapHasKey( mNeighbours, it->mId ) && ( mNeighbours[it->mId].mTimeStamp > it->mTimeStamp || mNeighbours[it->mId].mHopCount < it->mHopCount ) )
+			bool known;
+			if ( merge ) {
+				while ( pos != mNeighbours.end() && pos->first < it->mId )
+					pos++;
+				known = pos != mNeighbours.end() && pos->first == it->mId;
+				if ( !known )
+					pos = mNeighbours.insert( pos, NeighbourTable::value_type( it->mId, Neighbour() ) );
+			} else {
+				std::pair<NeighbourIterator,bool> r = mNeighbours.insert( NeighbourTable::value_type( it->mId, Neighbour() ) );
+				pos = r.first;
+				known = !r.second;
+			}
+
+			Neighbour &e = pos->second;
+			if ( known && ( e.mTimeStamp > it->mTimeStamp || e.mHopCount < it->mHopCount ) )
 				continue;	// We have more recent or closer data than this.
-			mNeighbours[it->mId].mId = it->mId;
-			mNeighbours[it->mId].mNetworkAddress = it->mNetworkAddress;
-			mNeighbours[it->mId].mPosition.x = it->mPositionX;
-			mNeighbours[it->mId].mPosition.y = it->mPositionY;
-			mNeighbours[it->mId].mVelocity.x = it->mVelocityX;
-			mNeighbours[it->mId].mVelocity.y = it->mVelocityY;
-		    mNeighbours[it->mId].mIsClusterHead = it->mIsClusterHead;
-		    mNeighbours[it->mId].mClusterHead = it->mClusterHead;
-			mNeighbours[it->mId].mConnectionCount = it->mConnectionCount;
-			mNeighbours[it->mId].mHopCount = it->mHopCount;
-			mNeighbours[it->mId].mTimeStamp = it->mTimeStamp;
-			mNeighbours[it->mId].mMissedPings = it->mMissedPings;
-		    mNeighbours[it->mId].mProviderId = id;
-		    mNeighbours[it->mId].mDistanceToNode = mMobility->getCurrentPosition().distance( mNeighbours[it->mId].mPosition );
-		    mNeighbours[it->mId].mLinkExpirationTime = CalculateLinkExpirationTime( mNeighbours[it->mId].mPosition, mNeighbours[it->mId].mVelocity );
-		    mNeighbours[it->mId].mDataOwner = this;
+			// The same entry relayed again by another CM is not a change worth sending on.
+			bool changed = !known || e.mTimeStamp < it->mTimeStamp || e.mHopCount != it->mHopCount || e.mProviderId != (unsigned int)id;
+			e.mId = it->mId;
+			e.mNetworkAddress = it->mNetworkAddress;
+			e.mPosition.x = it->mPositionX;
+			e.mPosition.y = it->mPositionY;
+			e.mVelocity.x = it->mVelocityX;
+			e.mVelocity.y = it->mVelocityY;
+		    e.mIsClusterHead = it->mIsClusterHead;
+		    e.mClusterHead = it->mClusterHead;
+			e.mConnectionCount = it->mConnectionCount;
+			e.mHopCount = it->mHopCount;
+			e.mTimeStamp = it->mTimeStamp;
+			e.mMissedPings = it->mMissedPings;
+		    e.mProviderId = id;
+		    e.mDistanceToNode = ownPosition.distance( e.mPosition );
+		    e.mLinkExpirationTime = CalculateLinkExpirationTime( e.mPosition, e.mVelocity, ownPosition, ownVelocity );
+		    mNeighbourGrid.set( it->mId, e.mPosition );
+		    if ( mClusterMembers.find( it->mId ) != mClusterMembers.end() )
+		    	mClusterExtent.set( it->mId, e.mPosition );
+		    e.mDataOwner = this;
+		    if ( mDeltaNeighbourTables && changed )
+		    	mNeighbourLog.touch( it->mId );
+
+		}
+
+	}
+
+	// Apply the removals in a delta table, and note what each side has received.
+	if ( mDeltaNeighbourTables && ( m->getKind() == POLL_MESSAGE || m->getKind() == POLL_ACK_MESSAGE ) ) {
 
+		NeighbourIdSet &removed = m->getRemovedNeighbours();
+		for ( NeighbourIdSetIterator it = removed.begin(); it != removed.end(); it++ ) {
+			// Only drop what we learnt through the sender.
+			NeighbourIterator n = mNeighbours.find( *it );
+			if ( n != mNeighbours.end() && n->second.mProviderId == (unsigned int)id && n->second.mHopCount > 1 )
+				RemoveNeighbour( *it );
 		}
 
+		// If the delta starts beyond what we have applied, we've missed some of it, so ask for the whole table.
+		if ( m->getTableBaseVersion() > mNeighbourLog.received( id ) )
+			mNeighbourLog.setReceived( id, 0 );
+		else
+			mNeighbourLog.setReceived( id, m->getTableVersion() );
+		mNeighbourLog.setAcknowledged( id, m->getTableAckVersion() );
+
 	}
 
 }
@@ -1430,78 +1559,72 @@ void RmacNetworkLayer::UpdateNeighbour( RmacControlMessage *m ) {
 
 
 
+void RmacNetworkLayer::RemoveNeighbour( int id ) {
 
-/**
- * @brief Sorting predicate for the Node Precidence Algorithm.
- *
- * This implements the sorting mechanism for the Node Precidence Algorithm.
- */
-bool RmacNetworkLayer::NPA::operator()( const int &id1, const int &id2 ) {
+	mNeighbours.erase( id );
+	mNeighbourGrid.erase( id );
+	if ( mDeltaNeighbourTables ) {
+		mNeighbourLog.remove( id );
+		mNeighbourLog.forgetPeer( id );
+	}
 
-	const Neighbour &n = mClient->GetNeighbour( id1 );
-	const Neighbour &m = mClient->GetNeighbour( id2 );
+}
 
-    // Has 'm' reached its maximum connection limits?
-    if ( m.mConnectionCount == n.mDataOwner->GetConnectionLimits() )
-        return true;    // 'n' has higher precidence.
 
-    // Has 'n' reached its maximum connection limits?
-    if ( n.mConnectionCount == n.mDataOwner->GetConnectionLimits() )
-        return false;   // 'm' has higher precidence.
 
-    // Is the difference in distance between this node and the others greater than a certain threshold?
-    if ( fabs( n.mDistanceToNode - m.mDistanceToNode ) >= n.mDataOwner->GetDistanceThreshold() ) {
+bool RmacNetworkLayer::RelaysNeighbour( const Neighbour &n, int id ) {
 
-        // Is 'n' closer than 'm'?
-        if ( n.mDistanceToNode < m.mDistanceToNode )
-            return true;    // 'n' has higher precidence.
-        else
-            return false;   // 'm' has higher precidence.
+	if ( n.mId == (unsigned int)id || n.mProviderId == (unsigned int)id )
+		return false;
+	if ( n.mPosition.distance( mNeighbours[id].mPosition ) > mZoneOfInterest )
+		return false;
+	return true;
 
-    }
+}
 
-    // Is the difference in LET greater than a certain threshold?
-    if ( fabs( n.mLinkExpirationTime - m.mLinkExpirationTime ) >= n.mDataOwner->GetTimeThreshold() ) {
 
-        // Is 'n' going to be in range longer than 'm'?
-        if ( n.mLinkExpirationTime > m.mLinkExpirationTime )
-            return true;    // 'n' has higher precidence.
-        else
-            return false;   // 'm' has higher precidence.
-    }
 
-    // Does 'n' have a larger cluster than 'm'?
-    if ( n.mConnectionCount > m.mConnectionCount )
-        return true;    // 'n' has higher precidence.
+void RmacNetworkLayer::AddNeighbourEntry( RmacControlMessage *pkt, const Neighbour &n ) {
 
-    return false;       // 'm' has higher precidence.
+	NeighbourEntry e;
+	e.mId = n.mId;
+	e.mNetworkAddress = n.mNetworkAddress;
+	e.mPositionX = n.mPosition.x;
+	e.mPositionY = n.mPosition.y;
+	e.mVelocityX = n.mVelocity.x;
+	e.mVelocityY = n.mVelocity.y;
+	e.mConnectionCount = n.mConnectionCount;
+	e.mHopCount = n.mHopCount+1;
+	e.mMissedPings = n.mMissedPings;
+	e.mTimeStamp = n.mTimeStamp;
+	pkt->getNeighbourTable().push_back(e);
 
 }
 
 
 
 
+
 void RmacNetworkLayer::UpdateLevelOfMember( int id, NodeIdList& record, bool eraseThis ) {
 
 	if ( ListHasValue( record, mId ) )
 		return;	// CYCLICAL CLUSTER STRUCTURE!
 
-	if ( !IsClusterHead() || !ListHasValue( mClusterMembers, id ) )
+	// A departing member has already left mClusterMembers, so look for its branch instead.
+	if ( !IsClusterHead() || !( eraseThis ? mBranchDepths.contains( id ) : mClusterMemberIndex.contains( id ) ) )
 		return;
 
-	// Assess changes to hierarchy and propagate them.
+	// Assess changes to hierarchy, and propagate them only if our longest branch changed.
 	RmacNetworkLayer *p;
 	if ( eraseThis ) {
-		mLevelLookup.erase(id);
+		mBranchDepths.erase(id);
 	} else {
 		p = dynamic_cast<RmacNetworkLayer*>( cSimulation::getActiveSimulation()->getModule( id ) );
-		mLevelLookup[id] = p->GetCurrentLevelCount();
-	}
-	mMaximumLevels = 0;
-	std::map<int,int>::iterator it;
-	for ( AllInVector( it, mLevelLookup ) ) {
-		mMaximumLevels = std::max( mMaximumLevels, it->second+1 );
+		mBranchDepths.set( id, p->GetCurrentLevelCount() );
 	}
+	if ( mBranchDepths.maximum() == mMaximumLevels )
+		return;
+	mMaximumLevels = mBranchDepths.maximum();
 
 	mCurrentLevels = std::max( mMaximumLevels, mCurrentLevels );
 
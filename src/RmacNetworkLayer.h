@@ -19,6 +19,13 @@
 #include <BaseNetwLayer.h>
 
 #include "ClusterAlgorithm.h"
+#include "ClusterExtent.h"
+#include "ClusterMemberIndex.h"
+#include "BloomFilter.h"
+#include "NeighbourChangeLog.h"
+#include "NeighbourSelection.h"
+#include "BranchDepths.h"
+#include "NeighbourGrid.h"
 
 /**
  * This module implements the clustering mechanism for Robust
@@ -297,11 +304,36 @@ protected:
 
     double CalculateLinkExpirationTime( Coord pos, Coord vel );
 
+    /**
+     * @brief Calculate the Link Expiration Time, given the position and velocity of this node.
+     * @param[in] pos Position of the target node.
+     * @param[in] vel Velocity of the target node.
+     * @param[in] p Position of this node.
+     * @param[in] v Velocity of this node.
+     * @return The time until the link expires.
+     */
+    double CalculateLinkExpirationTime( const Coord &pos, const Coord &vel, const Coord &p, const Coord &v );
+
     /**
      * Update neighbour data with the given message.
      */
     void UpdateNeighbour( RmacControlMessage *m );
 
+    /**
+     * Erase a neighbour from the table, logging the removal for delta tables.
+     */
+    void RemoveNeighbour( int id );
+
+    /**
+     * Check whether a neighbour is of interest to the given node, and so goes in the tables sent to it.
+     */
+    bool RelaysNeighbour( const Neighbour &n, int id );
+
+    /**
+     * Add a neighbour to the table in a frame.
+     */
+    void AddNeighbourEntry( RmacControlMessage *pkt, const Neighbour &n );
+
     /*@}*/
 
 
@@ -359,6 +391,10 @@ protected:
     double mPollInterval;					/**< Period for CHs polling  */
     double mPollTimeout;					/**< If a CM doesn't hear a POLL from the CH in this time, it departs the cluster. */
     unsigned int mMissedPingThreshold;		/**< Number of pings a node will miss before it is considered gone. */
+    double mClusterSummaryRate;				/**< False positive rate of the cluster summary in CLUS_PRES frames, or 0 to send the full member list. */
+    unsigned int mClusterSummaryMaxBits;	/**< Largest cluster summary to send, in bits, or 0 for no limit. */
+    NeighbourSelection::Priority mNeighbourTablePriority;	/**< Entries to send first when the neighbour table does not fit in a frame. */
+    bool mDeltaNeighbourTables;				/**< Send only the changed neighbour table entries in POLL and POLL_ACK frames. */
 
     /*@}*/
 
@@ -384,17 +420,14 @@ protected:
 
 
 
-    /**
-     * This implements the sorting mechanism for the Node Precidence Algorithm.
-     */
-    struct NPA {
-    	bool operator()( const int&, const int& );
-    	RmacNetworkLayer *mClient;
-    };
-
     NodeIdSet mTemporaryClusterRecord;		/**< When a node receives a SEND_CLUSTER_PRESENCE_MESSAGE, it stores the cluster member record here. */
+    ClusterExtent mClusterExtent;			/**< Positions of the cluster members, used to find the edge nodes. */
+    ClusterMemberIndex mClusterMemberIndex;	/**< Index of the cluster members, used to test for common members. */
+    BloomFilter mClusterSummary;			/**< Summary of the cluster members to send in CLUS_PRES frames. */
+    NeighbourChangeLog mNeighbourLog;		/**< Changes to the neighbour table, used to send delta tables. */
+    NeighbourGrid mNeighbourGrid;			/**< Positions of the neighbours, used to find those near a node. */
     NodeIdList mClusterHierarchy;			/**< List of heads of clusters within the hierarchy. This is used to prevent cyclical clusters. */
-    std::map<int,int> mLevelLookup;			/**< Lookup table of node IDs and the corresponding depth of their branches in the hierarchy. */
+    BranchDepths mBranchDepths;				/**< Depths of the branches of the hierarchy below each member. */
     int mMaximumLevels;						/**< Length of the longest branch at this point in the hierarchy. */
     int mCurrentLevels;						/**< The largest length this cluster has ever reached. */
 
@@ -52,12 +52,10 @@ void RouteSimilarityCluster::initialize( int stage ) {
 		TraCIScenarioManager *pManager = TraCIScenarioManagerAccess().get();
 		std::string myId = dynamic_cast<TraCIMobility*>(mMobility)->getExternalId();
 		std::string myRouteId = pManager->commandGetRouteId( myId );
-		mRouteList = pManager->commandGetRouteEdgeIds( myRouteId );
+		mRouteList.assign( pManager->commandGetRouteEdgeIds( myRouteId ) );
+		mTermCursor = mRouteList.cursor();
 
-//		std::cerr << "Route:\n";
-//		for ( RouteLinkList::iterator it = mRouteList.begin(); it != mRouteList.end(); it++ )
-//			std::cerr << *it << ", ";
-//		std::cerr << "\n";
+//		std::cerr << "Route: " << mRouteList << "\n";
 
 
     }
@@ -70,46 +68,46 @@ void RouteSimilarityCluster::initialize( int stage ) {
 /** Add the destination data to a packet. */
 int RouteSimilarityCluster::AddDestinationData( MdmacControlMessage *pkt ) {
 
-	// First check if the first id in the list is our current link.
-	while ( mRoadID != mRouteList.front() )
-		mRouteList.erase( mRouteList.begin() );
+	// Move the cursor up to our current link.
+	mRouteList.advanceTo( mRoadID );
 
-	// Check to make sure it didn't wipe the entire route list.
+	// Check to make sure we haven't run off the end of the route.
 	if ( mRouteList.empty() ) {
 		std::cerr << "STUB: node[" << mId << "] route end!\n";
 		return 0;
 	}
 //
-//	std::cerr << "Route:\n";
-//	for ( RouteLinkList::iterator it = mRouteList.begin(); it != mRouteList.end(); it++ )
-//		std::cerr << *it << ", ";
-//	std::cerr << "\n";
+//	std::cerr << "Route: " << mRouteList << "\n";
 
-	// Now add at most 'mLinkCount' number of links to the packet.
-	int size = 0;
-	RouteLinkList::iterator myListStart = mRouteList.begin();
-	for ( int i = 0; i < std::min( mLinkCount, (int)mRouteList.size() ); i++ ) {
+	// Now add at most 'mLinkCount' number of links to the packet, and return their size.
+	EdgeRoute &r = pkt->getRoute();
+	r.assign( mRouteList, mLinkCount );
+	return r.bitLength();
 
-		std::string currEdge = *myListStart;
-		pkt->getRoute().push_back( currEdge );
+}
 
-		// Add the number of bits used to encode the edge name.
-		size += currEdge.length()*8;
 
-		myListStart++;
+/** Store the destination data from a packet. */
+void RouteSimilarityCluster::StoreDestinationData( MdmacControlMessage *m ) {
 
-	}
+	int slot = mNeighbours.find( m->getNodeId() );
+	EdgeRoute &links = mNeighbours.mInfo[slot].mRouteLinks;
+	links = m->getRoute();
 
-	// Return the size.
-	return size;
+	// The match length only changes when the neighbour's links or our cursor do.
+	mNeighbours.setTerm( slot, mRouteList.commonPrefix( links, mLinkCount ) );
 
 }
 
 
-/** Store the destination data from a packet. */
-void RouteSimilarityCluster::StoreDestinationData( MdmacControlMessage *m ) {
 
-	mNeighbours[m->getNodeId()].mRouteLinks = m->getRoute();
+/** Recompute every neighbour's match length after our route cursor has moved. */
+void RouteSimilarityCluster::RefreshTerms() {
+
+	mTermCursor = mRouteList.cursor();
+	for ( unsigned int slot = 0; slot < mNeighbours.size(); slot++ )
+		mNeighbours.mTerm[slot] = mRouteList.commonPrefix( mNeighbours.mInfo[slot].mRouteLinks, mLinkCount );
+	mNeighbours.sumTerms();
 
 }
 
@@ -119,33 +117,16 @@ void RouteSimilarityCluster::StoreDestinationData( MdmacControlMessage *m ) {
 double RouteSimilarityCluster::calculateWeight() {
 
 	// This weight is the sum of percent route similarity between this node and its neighbours.
-	// The node iterates through its neighbour table and checks the route links it has logged.
-	// Starting from the beginning, the node adds 1/N to the weight for every matching link it finds.
+	// Each neighbour's term is the number of links that match, from the start, up to the first mismatch.
+	// The terms are kept in the neighbour table, which maintains their sum.
 
 	if ( !mMobility || mNeighbours.size() == 0 )
 		return 0;
 
-	double mScore = 0;
+	if ( mRouteList.cursor() != mTermCursor )
+		RefreshTerms();
 
-    for ( NeighbourIterator it = mNeighbours.begin(); it != mNeighbours.end(); it++ ) {
-
-    	RouteLinkList::iterator myListStart = mRouteList.begin();
-    	RouteLinkList::iterator theirListStart = it->second.mRouteLinks.begin();
-
-    	// Start looking for match ups.
-    	for ( int i = 0; i < std::min( mLinkCount, std::min( (int)mRouteList.size(), (int)it->second.mRouteLinks.size() ) ); i++ ) {
-
-    		if ( *myListStart != *theirListStart )
-    			break;	// Mismatch between routes, so bail out.
-
-    		// Got a match, so add it to the weight.
-    		mScore++;
-    		myListStart++;
-    		theirListStart++;
-
-    	}
-
-    }
+	double mScore = mNeighbours.termTotal();
 
 //	mScore /= mLinkCount;
 //	std::cerr << "Score(" << mId << ") = " << mScore << "\n";
@@ -40,7 +40,8 @@ public:
 protected:
 
     int mLinkCount;				/**< Number of look-ahead links to use. */
-    RouteLinkList mRouteList;	/**< List of route links. */
+    EdgeRoute mRouteList;		/**< Route of this node, with the cursor on the current link. */
+    unsigned int mTermCursor;	/**< Cursor of mRouteList when the neighbours' match lengths were computed. */
 
 
 	/** Add the destination data to a packet. */
@@ -49,6 +50,9 @@ protected:
 	/** Store the destination data from a packet. */
 	void StoreDestinationData( MdmacControlMessage *pkt );
 
+	/** Recompute every neighbour's match length after our route cursor has moved. */
+	void RefreshTerms();
+
 	/** @brief Compute the CH weight for this node. */
 	double calculateWeight();
 };
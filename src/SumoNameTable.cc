@@ -0,0 +1,79 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "SumoNameTable.h"
+
+
+SumoNameTable::NameIndex SumoNameTable::msIndex;
+std::vector<std::string> SumoNameTable::msNames;
+std::vector<unsigned int> SumoNameTable::msEdge;
+
+
+
+/** Get the ID of the given name, adding it to the table if needed. */
+unsigned int SumoNameTable::intern( const std::string &name ) {
+
+	std::pair<NameIndex::iterator,bool> r = msIndex.insert( NameIndex::value_type( name, msNames.size() ) );
+	if ( r.second ) {
+		msNames.push_back( name );
+		msEdge.push_back( r.first->second );
+	}
+	return r.first->second;
+
+}
+
+
+
+/** Get the ID of the given SUMO lane, adding the lane and its edge to the table if needed. */
+unsigned int SumoNameTable::internLane( const std::string &lane ) {
+
+	NameIndex::iterator it = msIndex.find( lane );
+	if ( it != msIndex.end() )
+		return it->second;
+
+	// SUMO lane names are the edge name followed by "_" and the lane index.
+	unsigned int edge = intern( lane.substr( 0, lane.find( "_" ) ) );
+	unsigned int id = intern( lane );
+	msEdge[id] = edge;
+	return id;
+
+}
+
+
+
+/** Get the name with the given ID. */
+const std::string& SumoNameTable::name( unsigned int id ) {
+
+	return msNames[id];
+
+}
+
+
+
+/** Get the ID of the edge a lane interned with internLane belongs to. */
+unsigned int SumoNameTable::edgeOf( unsigned int laneId ) {
+
+	return msEdge[laneId];
+
+}
+
+
+
+/** Get the number of names in the table. */
+unsigned int SumoNameTable::size() {
+
+	return msNames.size();
+
+}
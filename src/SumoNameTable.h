@@ -0,0 +1,62 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef __CLUSTERLIB_SUMONAMETABLE_H_
+#define __CLUSTERLIB_SUMONAMETABLE_H_
+
+#include <string>
+#include <vector>
+#include <map>
+
+
+/**
+ * Process-wide table of interned SUMO edge and lane names.
+ *
+ * Every distinct name is given a dense integer ID the first time it is
+ * seen, so road and lane comparisons and lookups can be done on integers.
+ * The IDs are only meaningful within one simulation process; they are
+ * never written to disk.
+ */
+class SumoNameTable {
+
+public:
+
+	/** Get the ID of the given name, adding it to the table if needed. */
+	static unsigned int intern( const std::string &name );
+
+	/** Get the ID of the given SUMO lane, adding the lane and its edge to the table if needed. */
+	static unsigned int internLane( const std::string &lane );
+
+	/** Get the name with the given ID. */
+	static const std::string& name( unsigned int id );
+
+	/** Get the ID of the edge a lane interned with internLane belongs to. */
+	static unsigned int edgeOf( unsigned int laneId );
+
+	/** Get the number of names in the table. */
+	static unsigned int size();
+
+protected:
+
+	typedef std::map<std::string,unsigned int> NameIndex;
+
+	static NameIndex msIndex;					/**< Lookup of name to ID. */
+	static std::vector<std::string> msNames;	/**< Name of each ID. */
+	static std::vector<unsigned int> msEdge;	/**< Edge ID of each lane ID. Names that are not lanes map to themselves. */
+
+};
+
+
+#endif
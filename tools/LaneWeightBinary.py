@@ -0,0 +1,71 @@
+#!/usr/bin/python
+
+import struct
+import sys
+from optparse import OptionParser
+
+# Converts a text lane weight file written by LaneWeight.py into the binary
+# format that LSUFData memory-maps (see src/LSUFData.h for the layout).
+
+LSUF_MAGIC = b"LSUF"
+LSUF_VERSION = 1
+
+def ReadText( fileName ):
+
+	f = open( fileName, "r" )
+	tokens = f.read().split()
+	f.close()
+
+	count = int( tokens[0] )
+	lanes = []
+	for i in range( 0, count ):
+		name, weight, flow = tokens[1+3*i:4+3*i]
+		lanes.append( [ name.encode( "ascii" ), float(weight), int(flow) ] )
+
+	return lanes
+
+
+def WriteBinary( lanes, fileName ):
+
+	# Sort by name so the loader can binary search the names byte-wise.
+	lanes = sorted( lanes, key=lambda l: l[0] )
+
+	offsets = []
+	names = b""
+	for lane in lanes:
+		if lane[2] < 0 or lane[2] > 254:
+			raise ValueError( "Flow ID of lane " + str(lane[0]) + " does not fit in a byte" )
+		offsets.append( len(names) )
+		names += lane[0] + b"\0"
+
+	n = len(lanes)
+	f = open( fileName, "wb" )
+	f.write( LSUF_MAGIC + struct.pack( "<III", LSUF_VERSION, n, len(names) ) )
+	f.write( struct.pack( "<%dI" % n, *offsets ) )
+	f.write( struct.pack( "<%df" % n, *[ l[1] for l in lanes ] ) )
+	f.write( struct.pack( "<%dB" % n, *[ l[2] for l in lanes ] ) )
+	f.write( names )
+	f.close()
+
+
+def ParseOptions():
+	optParser = OptionParser()
+	optParser.add_option("-i", "--in-file", dest="inFile", help="Define the text lane weight file (manditory)")
+	optParser.add_option("-o", "--out-file", dest="outFile", help="Define the output file.")
+	(options, args) = optParser.parse_args()
+
+	if not options.inFile:
+		optParser.print_help()
+		sys.exit()
+
+	if not options.outFile:
+		options.outFile = options.inFile + ".bin"
+
+	return options
+
+
+if __name__ == "__main__":
+	options = ParseOptions()
+	lanes = ReadText( options.inFile )
+	print( "Saving " + str(len(lanes)) + " binary lane weights to " + options.outFile )
+	WriteBinary( lanes, options.outFile )
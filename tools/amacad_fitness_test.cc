@@ -0,0 +1,253 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+// Randomized equivalence test for the AMACAD fitness cache.
+//
+// Drives AmacadFitnessCache the way AmacadNetworkLayer does, through a
+// random sequence of neighbour moves, destination changes, CMs joining
+// and leaving, and our own moves. After every step it runs a CH election
+// from the cached row sums and compares each score and the chosen CH with
+// the O(M^2) loop that CalculateF did before the cache.
+//
+// Cached sums are added in a different order from the loop, so scores are
+// compared to a relative tolerance, and a different CH is only accepted
+// when its score ties with the loop's choice.
+//
+// Usage: amacad_fitness_test [steps] [seed]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <map>
+#include <set>
+#include <algorithm>
+
+#include "AmacadFitnessCache.h"
+
+
+#define SELF_ID 1000000
+#define TOLERANCE 1e-9
+
+
+typedef AmacadFitnessCache::Motion Motion;
+
+
+struct Neighbour {
+	Motion mMotion;
+	unsigned int mDataVersion;
+};
+
+
+static std::map<unsigned int,Neighbour> gNeighbours;
+static std::set<unsigned int> gMembers;
+static Motion gSelf;
+static AmacadFitnessCache gFitness;
+static unsigned int gLastDataVersion = 0;
+
+
+static double uniform( double lo, double hi ) {
+
+	return lo + ( hi - lo ) * ( rand() / ( RAND_MAX + 1.0 ) );
+
+}
+
+
+static void randomPosition( Motion &m ) {
+
+	m.mX = uniform( 0, 2000 );
+	m.mY = uniform( 0, 2000 );
+	m.mSpeed = uniform( 0, 40 );
+
+}
+
+
+static void randomDestination( Motion &m ) {
+
+	// A few shared destinations, as from a destination file.
+	static const double dests[][2] = { { 0, 0 }, { 5000, 0 }, { 0, 5000 }, { 5000, 5000 } };
+	int d = rand() % 4;
+	m.mDestinationX = dests[d][0];
+	m.mDestinationY = dests[d][1];
+
+}
+
+
+/** Mirror of AmacadNetworkLayer::SetNeighbourMotion. */
+static void setNeighbourMotion( unsigned int id, const Motion &m ) {
+
+	Neighbour &n = gNeighbours[id];
+	n.mMotion = m;
+	n.mDataVersion = ++gLastDataVersion;
+
+}
+
+
+/** Mirror of AmacadNetworkLayer::UpdateFitnessCache. */
+static void updateFitnessCache() {
+
+	if ( !gFitness.matches( gMembers.begin(), gMembers.end() ) )
+		gFitness.assign( gMembers.begin(), gMembers.end() );
+
+	for ( unsigned int k = 0; k < gFitness.size(); k++ ) {
+		Neighbour &a = gNeighbours[gFitness.idOf( k )];
+		gFitness.set( k, a.mMotion, a.mDataVersion );
+	}
+
+}
+
+
+/** AmacadNetworkLayer::CalculateF, from the cache for CMs or by the full loop. */
+static double calculateF( int id, bool cached ) {
+
+	double ret = 0;
+	if ( id != -1 ) {
+
+		Motion &n = gNeighbours[id].mMotion;
+		ret = gFitness.term( n, gSelf );
+		if ( cached && gMembers.count( id ) ) {
+			updateFitnessCache();
+			ret += gFitness.sum( gFitness.slotOf( id ) );
+		} else {
+			for ( std::set<unsigned int>::iterator it = gMembers.begin(); it != gMembers.end(); it++ )
+				ret += gFitness.term( n, gNeighbours[*it].mMotion );
+		}
+
+	} else {
+
+		for ( std::set<unsigned int>::iterator it = gMembers.begin(); it != gMembers.end(); it++ )
+			ret += gFitness.term( gNeighbours[*it].mMotion, gSelf );
+
+	}
+	return ret;
+
+}
+
+
+/** AmacadNetworkLayer::ComputeNeighbourScores, returning the best score too. */
+static int electClusterHead( bool cached, double &bestScore ) {
+
+	bestScore = calculateF( -1, cached );
+	int bestID = SELF_ID;
+	for ( std::set<unsigned int>::iterator it = gMembers.begin(); it != gMembers.end(); it++ ) {
+		double currScore = calculateF( *it, cached );
+		if ( currScore < bestScore ) {
+			bestScore = currScore;
+			bestID = *it;
+		}
+	}
+	return bestID;
+
+}
+
+
+static bool close( double a, double b ) {
+
+	return fabs( a - b ) <= TOLERANCE * std::max( 1.0, std::max( fabs( a ), fabs( b ) ) );
+
+}
+
+
+int main( int argc, char **argv ) {
+
+	unsigned int steps = argc > 1 ? atoi( argv[1] ) : 5000;
+	srand( argc > 2 ? atoi( argv[2] ) : 1 );
+
+	gFitness.setWeights( uniform( 0.5, 2 ), uniform( 0.5, 2 ), uniform( 0.5, 2 ) );
+	randomPosition( gSelf );
+	randomDestination( gSelf );
+
+	unsigned int compared = 0, ties = 0, failures = 0;
+	double worst = 0;
+
+	for ( unsigned int step = 0; step < steps; step++ ) {
+
+		// Bias towards joins while the cluster is small, so it reaches a realistic size.
+		int op = rand() % 100;
+		unsigned int id = rand() % 120;
+		Motion m = gNeighbours[id].mMotion;
+		if ( op < 40 || gNeighbours[id].mDataVersion == 0 ) {
+
+			// A beacon: the neighbour has moved.
+			randomPosition( m );
+			if ( gNeighbours[id].mDataVersion == 0 )
+				randomDestination( m );
+			setNeighbourMotion( id, m );
+
+		} else if ( op < 50 ) {
+
+			// The neighbour has changed its destination.
+			randomDestination( m );
+			setNeighbourMotion( id, m );
+
+		} else if ( op < 58 ) {
+
+			// A cluster table entry that repeats what we know still gets a new version.
+			setNeighbourMotion( id, m );
+
+		} else if ( op < 75 && gMembers.size() < 60 ) {
+
+			gMembers.insert( id );
+
+		} else if ( op < 85 ) {
+
+			gMembers.erase( id );
+
+		} else if ( op < 95 ) {
+
+			randomPosition( gSelf );
+
+		} else {
+
+			randomDestination( gSelf );
+
+		}
+
+		// The module also computes the F value of whoever it last heard from.
+		calculateF( id, true );
+
+		double cachedScore, loopScore;
+		int cachedCH = electClusterHead( true, cachedScore );
+		int loopCH = electClusterHead( false, loopScore );
+		compared++;
+
+		bool ok = close( cachedScore, loopScore );
+		for ( std::set<unsigned int>::iterator it = gMembers.begin(); it != gMembers.end(); it++ ) {
+			double a = calculateF( *it, true ), b = calculateF( *it, false );
+			double err = fabs( a - b ) / std::max( 1.0, fabs( b ) );
+			if ( err > worst )
+				worst = err;
+			ok &= close( a, b );
+		}
+		if ( ok && cachedCH != loopCH ) {
+			double other = cachedCH == SELF_ID ? calculateF( -1, false ) : calculateF( cachedCH, false );
+			if ( close( other, loopScore ) )
+				ties++;
+			else
+				ok = false;
+		}
+
+		if ( !ok ) {
+			if ( failures < 10 )
+				printf( "FAILED: step %u, %lu CMs: cache chose %d (%.12g), full loop chose %d (%.12g)\n", step, (unsigned long)gMembers.size(), cachedCH, cachedScore, loopCH, loopScore );
+			failures++;
+		}
+
+	}
+
+	printf( "%u elections compared, %u tied; largest relative difference in F %.3g\n", compared, ties, worst );
+	printf( failures ? "FAILED\n" : "ok\n" );
+	return failures ? 1 : 0;
+
+}
@@ -0,0 +1,156 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+// Microbenchmark for testing CLUS_PRES frames against our cluster.
+//
+// For clusters of 10, 50, 100 and 500 members, times the old test of
+// EvaluateClusterPresence, which searched the received ID table linearly
+// for each of our members (O(|C||T|)), against ClusterMemberIndex::
+// intersects. Each size is run with the received table disjoint from our
+// cluster (the common case, and the worst for both) and sharing one
+// member, with dense module IDs and with some IDs beyond the bitmap.
+// Both tests must give the same answer every time.
+//
+// Usage: cluster_presence_bench [repeats]
+
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <vector>
+#include <algorithm>
+#include <sys/time.h>
+
+#include "ClusterMemberIndex.h"
+
+
+#define ListHasValue(l,v)  ( std::find(l.begin(),l.end(),v) != l.end() )
+
+#define TABLES 64
+
+
+/** Get the wall-clock time in seconds. */
+static double now() {
+
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+
+}
+
+
+/** Pick an ID not yet used; with sparse IDs, one in four is beyond the bitmap. */
+static unsigned int randomId( std::set<unsigned int> &used, bool sparse ) {
+
+	unsigned int id;
+	do {
+		if ( sparse && rand() % 4 == 0 )
+			id = ClusterMemberIndex::DENSE_LIMIT + rand() % 1000000;
+		else
+			id = 10 + rand() % 20000;
+	} while ( !used.insert( id ).second );
+	return id;
+
+}
+
+
+/** The test EvaluateClusterPresence did before the index: is any member in the table? */
+static bool listIntersects( const std::set<unsigned int> &members, const std::vector<unsigned int> &table ) {
+
+	for ( std::set<unsigned int>::const_iterator it = members.begin(); it != members.end(); it++ )
+		if ( ListHasValue( table, *it ) )
+			return true;
+	return false;
+
+}
+
+
+int main( int argc, char **argv ) {
+
+	unsigned int repeats = argc > 1 ? atoi( argv[1] ) : 200;
+	if ( repeats == 0 ) {
+		fprintf( stderr, "Usage: %s [repeats]\n", argv[0] );
+		return 2;
+	}
+
+	static const unsigned int SIZES[] = { 10, 50, 100, 500 };
+	bool ok = true;
+	srand( 1 );
+
+	printf( "%5s %-6s %-9s %12s %12s %8s\n", "size", "IDs", "table", "list ns", "index ns", "speedup" );
+
+	for ( unsigned int s = 0; s < sizeof( SIZES ) / sizeof( SIZES[0] ); s++ ) {
+		for ( int sparse = 0; sparse < 2; sparse++ ) {
+			for ( int common = 0; common < 2; common++ ) {
+
+				// Our cluster, and tables of the same size from other clusters.
+				unsigned int n = SIZES[s];
+				std::set<unsigned int> used, members;
+				ClusterMemberIndex index;
+				for ( unsigned int i = 0; i < n; i++ ) {
+					unsigned int id = randomId( used, sparse );
+					members.insert( id );
+					index.insert( id );
+				}
+
+				std::vector<std::vector<unsigned int> > tables( TABLES );
+				for ( unsigned int t = 0; t < TABLES; t++ ) {
+					std::set<unsigned int> tableUsed( used ), ids;
+					for ( unsigned int i = 0; i < n; i++ )
+						ids.insert( randomId( tableUsed, sparse ) );
+					if ( common ) {
+						// Swap one ID for one of our members, as senders fill the table from a set.
+						std::set<unsigned int>::iterator m = members.begin();
+						std::advance( m, rand() % n );
+						ids.erase( ids.begin() );
+						ids.insert( *m );
+					}
+					tables[t].assign( ids.begin(), ids.end() );
+				}
+
+				// Both tests must agree.
+				for ( unsigned int t = 0; t < TABLES; t++ ) {
+					bool a = listIntersects( members, tables[t] );
+					bool b = index.intersects( tables[t] );
+					if ( a != b || a != (bool)common ) {
+						printf( "FAILED: size %u, table %u: list says %d, index says %d\n", n, t, a, b );
+						ok = false;
+					}
+				}
+
+				unsigned int hits = 0;
+				double t0 = now();
+				for ( unsigned int r = 0; r < repeats; r++ )
+					for ( unsigned int t = 0; t < TABLES; t++ )
+						hits += listIntersects( members, tables[t] );
+				double t1 = now();
+				for ( unsigned int r = 0; r < repeats; r++ )
+					for ( unsigned int t = 0; t < TABLES; t++ )
+						hits += index.intersects( tables[t] );
+				double t2 = now();
+
+				double calls = (double)repeats * TABLES;
+				double list = ( t1 - t0 ) * 1e9 / calls, indexed = ( t2 - t1 ) * 1e9 / calls;
+				printf( "%5u %-6s %-9s %12.1f %12.1f %7.1fx\n", n, sparse ? "sparse" : "dense", common ? "1 common" : "disjoint", list, indexed, list / indexed );
+				if ( hits != ( common ? 2 * repeats * TABLES : 0 ) )
+					ok = false;
+
+			}
+		}
+	}
+
+	printf( ok ? "ok\n" : "FAILED\n" );
+	return ok ? 0 : 1;
+
+}
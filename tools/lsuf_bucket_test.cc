@@ -0,0 +1,255 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+// Randomized equivalence test for the LSUF flow buckets.
+//
+// Drives LSUFFlowBuckets the way LSUFCluster does, through a random
+// sequence of neighbour inserts, updates and expiries and of our own
+// moves and road changes, and after every step compares the utility read
+// from the buckets with the full scan over the neighbour table that
+// LSUFCluster::calculateWeight used to do.
+//
+// The buckets are only rebuilt once we have moved or changed velocity by
+// more than LSUFCluster's default tolerances. The test checks that the
+// buckets match the full scan from our state at the last rebuild, and
+// that they are within the bound the tolerances give of the full scan
+// from our current state. Where the full scan gives NaN, because we have
+// no neighbours or none in our flow, the buckets must give NaN too.
+//
+// Usage: lsuf_bucket_test [steps] [seed]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "LSUFFlowBuckets.h"
+
+
+// LSUFCluster's default bucketPositionTolerance and bucketVelocityTolerance.
+#define POSITION_TOLERANCE 1.0
+#define VELOCITY_TOLERANCE 0.5
+
+
+struct Node {
+	unsigned int mRoad;
+	unsigned char mFlow;
+	double mX, mY;
+	double mVX, mVY;
+};
+
+
+static double uniform( double lo, double hi ) {
+
+	return lo + ( hi - lo ) * ( rand() / ( RAND_MAX + 1.0 ) );
+
+}
+
+
+static Node randomNode() {
+
+	// A few roads and flows, so that every bucket sees plenty of traffic.
+	static const unsigned char flows[] = { 0, 1, 2, 3, 255 };
+	Node n;
+	n.mRoad = rand() % 3;
+	n.mFlow = flows[rand() % 5];
+	n.mX = uniform( 0, 1000 );
+	n.mY = uniform( 0, 1000 );
+	n.mVX = uniform( -30, 30 );
+	n.mVY = uniform( -30, 30 );
+	return n;
+
+}
+
+
+static float distance( double x0, double y0, double x1, double y1 ) {
+
+	return sqrt( ( x0 - x1 ) * ( x0 - x1 ) + ( y0 - y1 ) * ( y0 - y1 ) );
+
+}
+
+
+/** The full scan of LSUFCluster::calculateWeight before the buckets. */
+static double fullScan( const std::vector<Node> &table, const Node &self, float laneWeight ) {
+
+	int alpha = table.size();
+	int beta = 0;
+	float delta = 0, chi = 0, sigma = 0, rho = 0;
+	for ( unsigned int i = 0; i < table.size(); i++ ) {
+
+		if ( table[i].mRoad != self.mRoad )
+			continue;
+
+		float dist = distance( self.mX, self.mY, table[i].mX, table[i].mY );
+		float dv = distance( self.mVX, self.mVY, table[i].mVX, table[i].mVY );
+
+		delta += dist;
+		sigma += dv;
+
+		if ( table[i].mFlow == self.mFlow ) {
+			chi += dist;
+			rho += dv;
+			beta++;
+		}
+
+	}
+
+	delta /= alpha;
+	sigma /= alpha;
+	chi /= beta;
+	rho /= beta;
+
+	float NCL, ADL, AVL;
+
+	NCL =  beta + alpha * laneWeight;
+	ADL = delta +   chi * laneWeight;
+	AVL = sigma +   rho * laneWeight;
+
+	return NCL + ADL + AVL;
+
+}
+
+
+/** Check that two utilities agree to within the given slack, or are both NaN. */
+static bool agree( double got, double want, double slack ) {
+
+	if ( want != want )
+		return got != got;
+	return fabs( got - want ) <= slack + 1e-5 * std::max( 1.0, fabs( want ) );
+
+}
+
+
+/** Mirror of LSUFCluster::SetBucket. */
+static void setBucket( LSUFFlowBuckets &buckets, const std::vector<Node> &table, const Node &at, unsigned int slot, unsigned char flow ) {
+
+	const Node &n = table[slot];
+	buckets.set( slot, flow, n.mRoad == at.mRoad, distance( at.mX, at.mY, n.mX, n.mY ), distance( at.mVX, at.mVY, n.mVX, n.mVY ) );
+
+}
+
+
+int main( int argc, char **argv ) {
+
+	unsigned int steps = argc > 1 ? atoi( argv[1] ) : 200000;
+	srand( argc > 2 ? atoi( argv[2] ) : 1 );
+
+	std::vector<Node> table;
+	LSUFFlowBuckets buckets;
+	Node self = randomNode();
+	Node rebuiltAt = self;
+	bool valid = false;
+	float laneWeight = 1.5f;
+
+	unsigned int compared = 0, nans = 0, rebuilds = 0, failures = 0;
+	double worst = 0;
+
+	for ( unsigned int step = 0; step < steps; step++ ) {
+
+		// Bias towards inserts while the table is small, so it reaches a realistic size.
+		int op = rand() % 100;
+		if ( table.empty() || ( op < 30 && table.size() < 150 ) ) {
+
+			// A packet from a new neighbour (NeighbourUpdated on a new slot).
+			table.push_back( randomNode() );
+			unsigned int slot = table.size() - 1;
+			if ( valid )
+				setBucket( buckets, table, rebuiltAt, slot, table[slot].mFlow );
+			else
+				buckets.set( slot, table[slot].mFlow, false, 0, 0 );
+
+		} else if ( op < 60 ) {
+
+			// A packet from a known neighbour, which may have changed road and lane.
+			unsigned int slot = rand() % table.size();
+			table[slot] = randomNode();
+			if ( valid )
+				setBucket( buckets, table, rebuiltAt, slot, table[slot].mFlow );
+			else
+				buckets.set( slot, table[slot].mFlow, false, 0, 0 );
+
+		} else if ( op < 85 ) {
+
+			// A link expires (NeighbourErasing, then the table's swap-with-last erase).
+			unsigned int slot = rand() % table.size();
+			buckets.erase( slot );
+			table[slot] = table.back();
+			table.pop_back();
+
+		} else if ( op < 95 ) {
+
+			// We move, but stay on our road and lane. Most moves are small, and stay within the tolerances.
+			if ( rand() % 4 == 0 ) {
+				Node moved = randomNode();
+				moved.mRoad = self.mRoad;
+				moved.mFlow = self.mFlow;
+				self = moved;
+			} else {
+				self.mX += uniform( -0.6, 0.6 );
+				self.mY += uniform( -0.6, 0.6 );
+				self.mVX += uniform( -0.3, 0.3 );
+				self.mVY += uniform( -0.3, 0.3 );
+			}
+
+		} else {
+
+			// We change road and lane.
+			self = randomNode();
+			laneWeight = uniform( 0.5, 3 );
+
+		}
+
+		// calculateWeight: rebuild once we have moved past the tolerances, then read the buckets.
+		double moved = distance( self.mX, self.mY, rebuiltAt.mX, rebuiltAt.mY );
+		double turned = distance( self.mVX, self.mVY, rebuiltAt.mVX, rebuiltAt.mVY );
+		if ( !valid || self.mRoad != rebuiltAt.mRoad || moved > POSITION_TOLERANCE || turned > VELOCITY_TOLERANCE ) {
+			valid = true;
+			rebuiltAt = self;
+			moved = turned = 0;
+			rebuilds++;
+			buckets.clearSums();
+			for ( unsigned int i = 0; i < table.size(); i++ )
+				setBucket( buckets, table, rebuiltAt, i, buckets.flowOf( i ) );
+		}
+
+		double got = buckets.utility( self.mFlow, table.size(), laneWeight );
+		double exact = fullScan( table, rebuiltAt, laneWeight );
+		double want = fullScan( table, self, laneWeight );
+		compared++;
+		if ( want != want )
+			nans++;
+
+		// Each distance is off by at most how far we have moved, and each velocity difference
+		// by how much our velocity has changed, so each average is off by at most as much.
+		double slack = ( moved + turned ) * ( 1 + laneWeight );
+		if ( want == want && got == got ) {
+			double err = fabs( got - exact ) / std::max( 1.0, fabs( exact ) );
+			if ( err > worst )
+				worst = err;
+		}
+		if ( !agree( got, exact, 0 ) || !agree( got, want, slack ) ) {
+			if ( failures < 10 )
+				printf( "FAILED: step %u, %lu neighbours: buckets %.9g, full scan %.9g at the last rebuild and %.9g now\n", step, (unsigned long)table.size(), got, exact, want );
+			failures++;
+		}
+
+	}
+
+	printf( "%u steps compared, %u rebuilds, %u where the full scan gave NaN; largest relative difference at the last rebuild %.3g\n", compared, rebuilds, nans, worst );
+	printf( failures ? "FAILED\n" : "ok\n" );
+	return failures ? 1 : 0;
+
+}
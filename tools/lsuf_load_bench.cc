@@ -0,0 +1,227 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+// Load-time benchmark for the LSUF lane weight formats.
+//
+// Writes a synthetic network of lanes in the text and binary formats,
+// then times loading each file and looking up every lane once (the first
+// lookup of a binary lane searches the mapped file) and again (cached).
+// The binary results are checked against the text ones, and damaged
+// binary files are checked to be rejected rather than read out of bounds.
+//
+// Usage: lsuf_load_bench [lanes] [runs]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sys/time.h>
+
+#include "LSUFData.h"
+#include "SumoNameTable.h"
+
+
+#define TEXT_FILE "lsuf_bench.txt"
+#define BINARY_FILE "lsuf_bench.bin"
+#define DAMAGED_FILE "lsuf_bench_damaged.bin"
+
+
+struct Lane {
+	std::string mName;
+	float mWeight;
+	unsigned int mFlow;
+	bool operator<( const Lane &o ) const { return mName < o.mName; }
+};
+
+
+/** Get the wall-clock time in seconds. */
+static double now() {
+
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+
+}
+
+
+/** Write the lanes in the format of tools/LaneWeight.py. */
+static void writeText( const std::vector<Lane> &lanes, const char *filename ) {
+
+	std::ofstream outs( filename );
+	outs << lanes.size() << "\n";
+	for ( unsigned int i = 0; i < lanes.size(); i++ )
+		outs << lanes[i].mName << " " << lanes[i].mWeight << " " << lanes[i].mFlow << "\n";
+
+}
+
+
+/** Build the file that tools/LaneWeightBinary.py would write for the lanes. */
+static std::string binaryImage( std::vector<Lane> lanes ) {
+
+	std::sort( lanes.begin(), lanes.end() );
+
+	unsigned int n = lanes.size();
+	std::vector<unsigned int> offsets;
+	std::string names;
+	for ( unsigned int i = 0; i < n; i++ ) {
+		offsets.push_back( names.size() );
+		names += lanes[i].mName;
+		names += '\0';
+	}
+
+	unsigned int header[3] = { 1, n, (unsigned int)names.size() };
+	std::string image( "LSUF" );
+	image.append( (const char*)header, sizeof(header) );
+	image.append( (const char*)&offsets[0], n * sizeof(unsigned int) );
+	for ( unsigned int i = 0; i < n; i++ )
+		image.append( (const char*)&lanes[i].mWeight, sizeof(float) );
+	for ( unsigned int i = 0; i < n; i++ )
+		image += (char)lanes[i].mFlow;
+	image += names;
+	return image;
+
+}
+
+
+static void writeFile( const std::string &image, const char *filename ) {
+
+	std::ofstream outs( filename, std::ios::out | std::ios::binary );
+	outs.write( image.data(), image.size() );
+
+}
+
+
+/** Time loading a file and two passes of lookups over every lane. */
+static void timeLoad( const char *format, const char *filename, const std::vector<unsigned int> &ids, unsigned int runs ) {
+
+	double load = 0, first = 0, cached = 0;
+	double sum = 0;
+
+	for ( unsigned int r = 0; r < runs; r++ ) {
+
+		double t0 = now();
+		LSUFData data( filename );
+		double t1 = now();
+		for ( unsigned int i = 0; i < ids.size(); i++ )
+			sum += data.getLaneWeight( ids[i] ).mWeight;
+		double t2 = now();
+		for ( unsigned int i = 0; i < ids.size(); i++ )
+			sum += data.getLaneWeight( ids[i] ).mWeight;
+		double t3 = now();
+
+		load += t1 - t0;
+		first += t2 - t1;
+		cached += t3 - t2;
+
+	}
+
+	printf( "%-8s load %9.3f ms   first lookups %9.3f ms   cached lookups %9.3f ms   (checksum %g)\n",
+			format, 1e3 * load / runs, 1e3 * first / runs, 1e3 * cached / runs, sum );
+
+}
+
+
+/** Check that loading the file throws. */
+static bool rejects( const std::string &image, const char *what ) {
+
+	writeFile( image, DAMAGED_FILE );
+	try {
+		LSUFData data( DAMAGED_FILE );
+	} catch ( const char* ) {
+		return true;
+	}
+	printf( "FAILED: %s was accepted\n", what );
+	return false;
+
+}
+
+
+int main( int argc, char **argv ) {
+
+	unsigned int count = argc > 1 ? atoi( argv[1] ) : 20000;
+	unsigned int runs = argc > 2 ? atoi( argv[2] ) : 20;
+	if ( count == 0 || runs == 0 ) {
+		fprintf( stderr, "Usage: %s [lanes] [runs]\n", argv[0] );
+		return 2;
+	}
+
+	srand( 1 );
+	std::vector<Lane> lanes( count );
+	std::vector<unsigned int> ids( count );
+	for ( unsigned int i = 0; i < count; i++ ) {
+		char name[32];
+		sprintf( name, "%u#%u_%u", rand() % 100000, i, rand() % 4 );
+		lanes[i].mName = name;
+		lanes[i].mWeight = ( rand() % 1000 ) / 100.0f;
+		lanes[i].mFlow = rand() % 10;
+		ids[i] = SumoNameTable::internLane( name );
+	}
+
+	std::string image = binaryImage( lanes );
+	writeText( lanes, TEXT_FILE );
+	writeFile( image, BINARY_FILE );
+	printf( "%u lanes, %u runs; text file %lu bytes, binary file %lu bytes\n",
+			count, runs, (unsigned long)std::ifstream( TEXT_FILE, std::ios::ate ).tellg(), (unsigned long)image.size() );
+
+	timeLoad( "text", TEXT_FILE, ids, runs );
+	timeLoad( "binary", BINARY_FILE, ids, runs );
+
+	// Both formats must give every lane the same weight and flow.
+	bool ok = true;
+	{
+		LSUFData text( TEXT_FILE );
+		LSUFData binary( BINARY_FILE );
+		for ( unsigned int i = 0; i < count && ok; i++ ) {
+			LSUFData::LaneWeight a = text.getLaneWeight( ids[i] );
+			LSUFData::LaneWeight b = binary.getLaneWeight( ids[i] );
+			if ( a.mWeight != b.mWeight || a.mFlowID != b.mFlowID || a.mState != b.mState ) {
+				printf( "FAILED: lane %s differs between the formats\n", lanes[i].mName.c_str() );
+				ok = false;
+			}
+		}
+	}
+
+	// Damaged binary files must be rejected when they are loaded.
+	unsigned int tableEnd = 16 + count * 9;
+	ok &= rejects( image.substr( 0, 10 ), "a file cut inside the header" );
+	ok &= rejects( image.substr( 0, 16 + count * 2 ), "a file cut inside the offsets" );
+	ok &= rejects( image.substr( 0, image.size() - 1 ), "a file cut inside the names" );
+	std::string damaged = image;
+	unsigned int huge = 0x40000000;
+	memcpy( &damaged[8], &huge, 4 );
+	ok &= rejects( damaged, "a file with a huge lane count" );
+	damaged = image;
+	unsigned int offset = image.size();
+	memcpy( &damaged[16 + 4 * ( count / 2 )], &offset, 4 );
+	ok &= rejects( damaged, "a file with a name offset past its end" );
+	damaged = image;
+	damaged[damaged.size() - 1] = 'x';
+	ok &= rejects( damaged, "a file whose last name is not terminated" );
+	damaged = image;
+	unsigned int nameBytes = image.size() - tableEnd + 1;
+	memcpy( &damaged[12], &nameBytes, 4 );
+	ok &= rejects( damaged, "a file with too many name bytes" );
+
+	remove( TEXT_FILE );
+	remove( BINARY_FILE );
+	remove( DAMAGED_FILE );
+
+	printf( ok ? "ok\n" : "FAILED\n" );
+	return ok ? 0 : 1;
+
+}
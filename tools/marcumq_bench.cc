@@ -0,0 +1,257 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+// Accuracy and throughput benchmark for the Marcum Q kernels.
+//
+// Samples (a, b) at one random point in each cell of a grid, for several
+// orders M, and for each kernel reports the time per
+// call, the number of series terms summed, and the largest absolute and
+// relative error against a 50-digit reference. CRAC calls the kernels
+// with a = A/sigma and b = rxSens d^2/(txPower lambda/4pi^2 sigma),
+// which in practice stay within a in [0,30] and b in [0,40]; that is the
+// default sweep. The points are random so that they fall between the
+// samples of MarcumQTable's grid, where its interpolation error lies;
+// the seed is fixed, so runs are repeatable. CRAC only uses M = 1, and kernels that only compute
+// Q_1 are skipped for other orders.
+//
+// The reference sums the Poisson mixture form of Q_M,
+//     Q_M(a,b) = sum_k e^(-a^2/2) (a^2/2)^k / k! * Q(k+M,b^2/2),
+// in 50-digit arithmetic. Every term is positive, so the sum is accurate
+// to far more digits than a double holds, even deep in the tails.
+//
+// A replacement kernel is benchmarked by writing a function of type
+// Kernel and adding it to KERNELS below.
+//
+// The exit status is 1 if any kernel gives a non-finite result.
+//
+// Usage: marcumq_bench [step] [repeats] [aMax] [bMax]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <sys/time.h>
+
+#include <boost/multiprecision/cpp_bin_float.hpp>
+
+#include "MarcumQ.h"
+#include "MarcumQTable.h"
+
+
+typedef boost::multiprecision::cpp_bin_float_50 Real;
+
+
+/**
+ * A kernel computes q[i] = Q_M(a[i],b[i]) for n pairs. If iterations is
+ * not NULL, it sets iterations[i] to the number of terms summed for each
+ * pair, or leaves it at 0 if it does not sum a series.
+ */
+typedef void (*Kernel)( const double *a, const double *b, int M, double *q, unsigned int n, unsigned int *iterations );
+
+
+struct KernelInfo {
+	const char *mName;			/**< Name shown in the report. */
+	Kernel mKernel;				/**< The kernel. */
+	bool mFirstOrderOnly;		/**< Can it only compute Q_1? */
+};
+
+
+static MarcumQTable *gTable = NULL;
+
+
+/** MarcumQ(), one pair at a time. */
+static void scalarKernel( const double *a, const double *b, int M, double *q, unsigned int n, unsigned int *iterations ) {
+
+	for ( unsigned int i = 0; i < n; i++ ) {
+		int terms = 0;
+		try {
+			q[i] = MarcumQ( a[i], b[i], M, &terms );
+		} catch ( std::exception & ) {
+			q[i] = NAN;		// Reported as non-finite.
+		}
+		if ( iterations )
+			iterations[i] = terms;
+	}
+
+}
+
+
+/** MarcumQ1(), all pairs in one batch. */
+static void batchKernel( const double *a, const double *b, int, double *q, unsigned int n, unsigned int *iterations ) {
+
+	unsigned int terms;
+	MarcumQ1( a, b, q, n, &terms );
+	if ( iterations ) {
+		for ( unsigned int i = 0; i < n; i++ )
+			iterations[i] = terms;
+	}
+
+}
+
+
+/** MarcumQTable::lookup(), with the table CRAC builds by default. */
+static void tableKernel( const double *a, const double *b, int, double *q, unsigned int n, unsigned int * ) {
+
+	for ( unsigned int i = 0; i < n; i++ )
+		q[i] = gTable->lookup( a[i], b[i] );
+
+}
+
+
+static const KernelInfo KERNELS[] = {
+	{ "MarcumQ", scalarKernel, false },
+	{ "MarcumQ1", batchKernel, true },
+	{ "MarcumQTable", tableKernel, true },
+};
+
+
+/** Compute Q_M(a,b) to 50 digits. */
+static Real reference( double a, double b, int M ) {
+
+	Real alpha = Real( a ) * a / 2;
+	Real beta = Real( b ) * b / 2;
+
+	// g is each term of the series of the upper incomplete gamma function, u its sum so far.
+	Real g = exp( -beta );
+	Real u = 0;
+	int j = 0;
+	for ( ; j < M; j++ ) {
+		u += g;
+		g *= beta / ( j + 1 );
+	}
+
+	// The gamma terms grow with k while the Poisson weights shrink, so when
+	// b is well above a the largest terms lie far beyond the mean of a^2/2.
+	// Stop once the terms are past both a^2/2 and b^2/2 and no longer
+	// change the sum.
+	double mean = std::max( a * a / 2, b * b / 2 );
+	Real w = exp( -alpha );
+	Real q = 0;
+	for ( int k = 0; k < 1000000; k++ ) {
+		Real term = w * u;
+		q += term;
+		if ( k > mean && term <= q * 1e-55 )
+			break;
+		w *= alpha / ( k + 1 );
+		u += g;
+		g *= beta / ( ++j );
+	}
+
+	return q;
+
+}
+
+
+/** Get the wall-clock time in seconds. */
+static double now() {
+
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+
+}
+
+
+int main( int argc, char **argv ) {
+
+	double step = argc > 1 ? atof( argv[1] ) : 0.5;
+	unsigned int repeats = argc > 2 ? atoi( argv[2] ) : 20;
+	double aMax = argc > 3 ? atof( argv[3] ) : 30;
+	double bMax = argc > 4 ? atof( argv[4] ) : 40;
+	if ( !( step > 0 ) || repeats == 0 || !( aMax >= 0 ) || !( bMax >= 0 ) ) {
+		fprintf( stderr, "Usage: %s [step] [repeats] [aMax] [bMax]\n", argv[0] );
+		return 2;
+	}
+
+	// CRAC only uses the table if lossTableSpacing is set; this is the table it
+	// builds for lossTableSpacing = 0.5 and the default lossTableRange and lossTableMaxError.
+	gTable = MarcumQTable::get( 20, 0.5, 1e-3, "" );
+	printf( "Table: spacing %g, measured error %.3g\n", gTable->spacing(), gTable->error() );
+
+	std::vector<double> a, b;
+	srand( 1 );
+	for ( double x = 0; x < aMax; x += step )
+		for ( double y = 0; y < bMax; y += step ) {
+			a.push_back( std::min( aMax, x + step * ( rand() / ( RAND_MAX + 1.0 ) ) ) );
+			b.push_back( std::min( bMax, y + step * ( rand() / ( RAND_MAX + 1.0 ) ) ) );
+		}
+	unsigned int n = a.size();
+
+	static const int ORDERS[] = { 1, 2, 5 };
+	printf( "%u random points of a in [0,%g], b in [0,%g], one per %g x %g cell; %u timing repeats\n\n", n, aMax, bMax, step, step, repeats );
+	bool ok = true;
+	printf( "%-13s %2s %10s %10s %10s %11s %11s %18s %10s\n", "kernel", "M", "ns/call", "mean terms", "max terms", "max abs err", "max rel err", "at (a, b)", "non-finite" );
+
+	for ( unsigned int o = 0; o < sizeof( ORDERS ) / sizeof( ORDERS[0] ); o++ ) {
+
+		int M = ORDERS[o];
+		std::vector<double> ref( n );
+		for ( unsigned int i = 0; i < n; i++ )
+			ref[i] = reference( a[i], b[i], M ).convert_to<double>();
+
+		for ( unsigned int k = 0; k < sizeof( KERNELS ) / sizeof( KERNELS[0] ); k++ ) {
+
+			const KernelInfo &kernel = KERNELS[k];
+			if ( kernel.mFirstOrderOnly && M != 1 )
+				continue;
+
+			std::vector<double> q( n );
+			std::vector<unsigned int> terms( n, 0 );
+			kernel.mKernel( &a[0], &b[0], M, &q[0], n, &terms[0] );
+
+			double t0 = now();
+			for ( unsigned int r = 0; r < repeats; r++ )
+				kernel.mKernel( &a[0], &b[0], M, &q[0], n, NULL );
+			double ns = ( now() - t0 ) * 1e9 / ( (double)repeats * n );
+
+			// Relative error is measured where the reference is a normal double.
+			double absErr = 0, relErr = 0, meanTerms = 0;
+			unsigned int maxTerms = 0, nonFinite = 0, worst = 0;
+			for ( unsigned int i = 0; i < n; i++ ) {
+				meanTerms += terms[i];
+				if ( terms[i] > maxTerms )
+					maxTerms = terms[i];
+				if ( !( fabs( q[i] ) <= 1e308 ) ) {
+					nonFinite++;
+					continue;
+				}
+				double e = fabs( q[i] - ref[i] );
+				if ( e > absErr )
+					absErr = e;
+				if ( ref[i] >= 2.3e-308 && e / ref[i] > relErr ) {
+					relErr = e / ref[i];
+					worst = i;
+				}
+			}
+			meanTerms /= n;
+			ok &= nonFinite == 0;
+
+			char at[48];
+			sprintf( at, "(%.4g, %.4g)", a[worst], b[worst] );
+			if ( maxTerms > 0 )
+				printf( "%-13s %2d %10.1f %10.1f %10u %11.3g %11.3g %18s %10u\n", kernel.mName, M, ns, meanTerms, maxTerms, absErr, relErr, at, nonFinite );
+			else
+				printf( "%-13s %2d %10.1f %10s %10s %11.3g %11.3g %18s %10u\n", kernel.mName, M, ns, "-", "-", absErr, relErr, at, nonFinite );
+
+		}
+
+	}
+
+	gTable->release();
+	return ok ? 0 : 1;
+
+}